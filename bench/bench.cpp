@@ -0,0 +1,261 @@
+// 离屏基准：载入模型后连续 draw 若干帧，输出每帧平均耗时，不依赖窗口。
+//   bench [--obj 路径 | --sphere 三角形数] [--texture] [--copies n] [--frames n] [--inflight 1|2] [--present 微秒]
+//         [--pipeline forward|visibility|prepass] [--simd scalar|sse4|avx2|avx512]
+//   bench --suite inflight   帧流水线：1 / 2 帧在飞行 × 模拟显示耗时 0 / 2 / 5 ms
+//   bench --suite precision  标量精度：spot 与 100 万三角形的球，标量与自动选择的 SIMD 级别；
+//                            float / double 对比需另建一个 -DRASTERIZER_DOUBLE=ON 的构建目录再跑一遍
+//   bench --suite transform  批量顶点变换：transformPoints 各级内核的吞吐，以及 30 个 spot 在各级别下的帧时间
+// 默认画 models/spot，700x700；RASTERIZER_SIMD 环境变量同样生效
+#include "rasterizer.h"
+#include "model.h"
+#include "cpuFeature.h"
+#include "float4x4.h"
+#include "alignedAllocator.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+using namespace std;
+
+struct benchConfig
+{
+    string obj = BENCH_MODEL_DIR "/spot/spot_triangulated_good.obj";
+    int sphere = 0; // > 0 时不读 obj，改画约这么多个三角形的经纬球（半径 1，带法线与纹理坐标）
+    bool texture = false;
+    int copies = 0;     // 在后方再放几个副本，制造遮挡
+    int frames = 300;
+    int inflight = 1;
+    int presentUs = 0;  // 模拟显示一帧的耗时：主线程读帧缓冲直到时间用完
+    renderPipeline pipeline = renderPipeline::forward;
+};
+
+static const int width = 700, height = 700, warmup = 10;
+
+static const char *pipelineName(renderPipeline p)
+{
+    return p == renderPipeline::visibility ? "visibility" : p == renderPipeline::depthPrepass ? "prepass" : "forward";
+}
+
+static void present(span<uint32_t> frame, int us)
+{
+    auto until = chrono::steady_clock::now() + chrono::microseconds(us);
+    volatile uint32_t sink = 0;
+    while (chrono::steady_clock::now() < until)
+        for (uint32_t p : frame.subspan(0, 4096))
+            sink = sink + p;
+}
+
+static void buildSphere(model &m, int triangles)
+{
+    int stacks = max(2, int(sqrt(triangles / 4.0))), slices = max(3, triangles / (2 * stacks));
+    for (int i = 0; i <= stacks; i++)
+        for (int j = 0; j <= slices; j++)
+        {
+            double u = double(j) / slices, v = double(i) / stacks;
+            double theta = u * 2 * M_PI, phi = v * M_PI;
+            vec3 p(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta));
+            m.addVertex(p, p, u, v);
+        }
+    for (int i = 0; i < stacks; i++)
+        for (int j = 0; j < slices; j++)
+        {
+            uint32_t a = i * (slices + 1) + j, b = a + 1, c = a + slices + 1, d = c + 1;
+            m.addTriangle(a, c, b);
+            m.addTriangle(b, c, d);
+        }
+}
+
+// 返回每帧毫秒数，载入失败返回负数
+static double runScene(const benchConfig &c, int &triangles)
+{
+    model mod;
+    if (c.sphere > 0)
+        buildSphere(mod, c.sphere);
+    else if (!mod.loadObj(c.obj.c_str()))
+        return -1;
+    triangles = mod.triangleCount();
+    if (c.texture)
+        mod.loadTexture(BENCH_MODEL_DIR "/spot/spot_texture.png");
+    mod.modelMatrix = model::scaling(vec3(2.5, 2.5, 2.5)) * model::rotation(140, vec3(0, 1, 0));
+    vector<model> copies;
+    copies.reserve(c.copies);
+    for (int i = 1; i <= c.copies; i++)
+        copies.push_back(mod.translate(vec3(0.1 * i, 0, -0.5 * i)));
+
+    camera cam;
+    cam.init(vec3(0, 0, 10), 45, 0.1, 50);
+    cam.setViewTarget(vec3(0, 0, 0));
+    rasterizer ras(width, height);
+    ras.setBkColor(220, 230, 210);
+    ras.setCamera(cam);
+    ras.addLight(vec3(20, 20, 20));
+    ras.addLight(vec3(-20, 20, 0));
+    ras.setPipeline(c.pipeline);
+    ras.setFramesInFlight(c.inflight);
+    ras.pushModel(mod);
+    for (model &m : copies)
+        ras.pushModel(m);
+
+    for (int i = 0; i < warmup; i++)
+        present(ras.draw(), c.presentUs);
+    auto t0 = chrono::steady_clock::now();
+    for (int i = 0; i < c.frames; i++)
+        present(ras.draw(), c.presentUs);
+    ras.finish();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / c.frames;
+}
+
+static bool report(const benchConfig &c)
+{
+    int triangles = 0;
+    double ms = runScene(c, triangles);
+    if (ms < 0)
+    {
+        fprintf(stderr, "failed to load %s\n", c.obj.c_str());
+        return false;
+    }
+    printf("%-7s %-6s %-10s tris %7d copies %d texture %d inflight %d present %5d us   %8.2f ms/frame\n",
+           cpuFeature::name(cpuFeature::level()), sizeof(real) == sizeof(float) ? "float" : "double",
+           pipelineName(c.pipeline), triangles, c.copies, int(c.texture), c.inflight, c.presentUs, ms);
+    return true;
+}
+
+static bool suiteInflight(benchConfig c)
+{
+    c.texture = true;
+    for (int present : {0, 2000, 5000})
+        for (int inflight : {1, 2})
+        {
+            c.presentUs = present;
+            c.inflight = inflight;
+            if (!report(c))
+                return false;
+        }
+    return true;
+}
+
+// 标量路径的插值与着色受 real 影响最大，几何量大的场景差别在顶点与三角形设置上
+static bool suitePrecision(benchConfig c)
+{
+    c.texture = true;
+    simdLevel best = cpuFeature::level();
+    for (int sphere : {0, 1000000})
+    {
+        c.sphere = sphere;
+        c.frames = sphere ? min(c.frames, 50) : c.frames;
+        for (simdLevel l : {simdLevel::scalar, best})
+        {
+            cpuFeature::setLevel(l);
+            if (!report(c))
+                return false;
+        }
+    }
+    cpuFeature::setLevel(best);
+    return true;
+}
+
+static const simdLevel allLevels[] = {simdLevel::scalar, simdLevel::sse4, simdLevel::avx2, simdLevel::avx512};
+
+// 只测变换内核本身：100 万个点原地变换，取多次的平均
+static void transformThroughput()
+{
+    const size_t n = 1 << 20;
+    const int rounds = 50;
+    alignedVector<vec4> pts(n);
+    for (size_t i = 0; i < n; i++)
+        pts[i] = {float(i % 1000) * 0.001f, float(i % 997) * 0.002f, float(i % 991) * 0.003f, 1};
+    float4x4 m(model::rotation(30, vec3(0.3, 0.5, 0.8)) * model::translation(vec3(0.5, -1, 2)));
+    for (simdLevel l : allLevels)
+    {
+        if (l > cpuFeature::detected())
+            break;
+        cpuFeature::setLevel(l);
+        transformPoints(m, pts, pts);
+        auto t0 = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; r++)
+            transformPoints(m, pts, pts);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / rounds;
+        printf("%-7s transformPoints %zu points   %8.3f ms   %6.2f Mpoints/s\n", cpuFeature::name(l), n, ms, n / ms / 1000);
+    }
+}
+
+static bool suiteTransform(benchConfig c)
+{
+    simdLevel best = cpuFeature::level();
+    transformThroughput();
+    c.copies = 29;
+    for (simdLevel l : allLevels)
+    {
+        if (l > best)
+            break;
+        cpuFeature::setLevel(l);
+        if (!report(c))
+            return false;
+    }
+    cpuFeature::setLevel(best);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    benchConfig c;
+    string suite;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        const char *next = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (arg == "--texture")
+            c.texture = true;
+        else if (!next)
+        {
+            fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return 1;
+        }
+        else
+        {
+            i++;
+            if (arg == "--obj")
+                c.obj = next;
+            else if (arg == "--sphere")
+                c.sphere = atoi(next);
+            else if (arg == "--copies")
+                c.copies = atoi(next);
+            else if (arg == "--frames")
+                c.frames = max(1, atoi(next));
+            else if (arg == "--inflight")
+                c.inflight = atoi(next);
+            else if (arg == "--present")
+                c.presentUs = atoi(next);
+            else if (arg == "--pipeline")
+                c.pipeline = !strcmp(next, "visibility") ? renderPipeline::visibility : !strcmp(next, "prepass") ? renderPipeline::depthPrepass : renderPipeline::forward;
+            else if (arg == "--simd")
+            {
+                for (simdLevel l : allLevels)
+                    if (!strcmp(next, cpuFeature::name(l)))
+                        cpuFeature::setLevel(l);
+            }
+            else if (arg == "--suite")
+                suite = next;
+            else
+            {
+                fprintf(stderr, "unknown option %s\n", arg.c_str());
+                return 1;
+            }
+        }
+    }
+    if (suite == "inflight")
+        return suiteInflight(c) ? 0 : 1;
+    if (suite == "precision")
+        return suitePrecision(c) ? 0 : 1;
+    if (suite == "transform")
+        return suiteTransform(c) ? 0 : 1;
+    if (!suite.empty())
+    {
+        fprintf(stderr, "unknown suite %s\n", suite.c_str());
+        return 1;
+    }
+    return report(c) ? 0 : 1;
+}
@@ -2,39 +2,42 @@
 #include <initializer_list>
 #include "Point.h"
 #include "Triangle.h"
-class Matrix
+template <typename T>
+class MatrixT
 {
 private:
     void init(std::initializer_list<std::initializer_list<double>> list);
-    double data[4 * 4];
+    T data[4 * 4];
 
 public:
-    Matrix(std::initializer_list<std::initializer_list<double>> list);
-    Matrix();
+    MatrixT(std::initializer_list<std::initializer_list<double>> list);
+    MatrixT();
     void printData();
 
-    Matrix &operator=(std::initializer_list<std::initializer_list<double>> list);
+    MatrixT &operator=(std::initializer_list<std::initializer_list<double>> list);
 
-    Matrix operator*(Matrix m);
-    void operator*=(Matrix m);
+    MatrixT operator*(MatrixT m);
+    void operator*=(MatrixT m);
 
-    Triangle operator*(Triangle tri);
+    TriangleT<T> operator*(TriangleT<T> tri);
 
-    Matrix operator*(double f);
-    void operator*=(double f);
+    MatrixT operator*(T f);
+    void operator*=(T f);
 
-    Matrix operator+(Matrix m);
-    void operator+=(Matrix m);
+    MatrixT operator+(MatrixT m);
+    void operator+=(MatrixT m);
 
-    double &getData(int row, int col) { return data[row * 4 + col]; }
-    void setData(int row, int col, double newData) { data[row * 4 + col] = newData; }
+    T &getData(int row, int col) { return data[row * 4 + col]; }
+    void setData(int row, int col, T newData) { data[row * 4 + col] = newData; }
 
-    Point operator*(Point p);
-    vec3 operator*(vec3 v);
+    PointT<T> operator*(PointT<T> p);
+    vec3T<T> operator*(vec3T<T> v);
 
-    Matrix trans();
+    MatrixT trans();
 
-    Matrix inverse();
+    MatrixT inverse();
 
-    static Matrix identity();
-};
\ No newline at end of file
+    static MatrixT identity();
+};
+
+using Matrix = MatrixT<real>;
@@ -2,24 +2,29 @@
 #include <initializer_list>
 #include "vec.h"
 
-class Point
+template <typename T>
+class TriangleT;
+
+template <typename T>
+class PointT
 {
 private:
-    friend class Triangle;
+    friend class TriangleT<T>;
 
-    Point normalize();
+    PointT normalize();
 
 public:
-    double data[4];
-    Point();
-    Point(std::initializer_list<double> list);
+    T data[4];
+    PointT();
+    // 初始化列表统一按 double 接收，单精度实例也能直接用双精度表达式构造
+    PointT(std::initializer_list<double> list);
 
     void printData();
-    Point &operator=(std::initializer_list<double> list);
-
-    double &operator[](int idx);
+    PointT &operator=(std::initializer_list<double> list);
 
-    Point operator-(Point& p);
+    T &operator[](int idx);
 
+    PointT operator-(PointT &p);
 };
 
+using Point = PointT<real>;
@@ -4,27 +4,405 @@
 #include <future>
 #include <atomic>
 #include <vector>
-#include <queue>
+#include <deque>
+#include <memory>
 #include <functional>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <type_traits>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
+// Chase-Lev 工作窃取双端队列：所有者在底部 push / pop，其他线程从顶部 steal
+// 环形数组满了就翻倍，旧数组留到析构再释放，正在 steal 的线程可能还在读它
+template <typename T>
+class workStealingDeque
+{
+private:
+    struct ring
+    {
+        int64_t mask;
+        std::unique_ptr<std::atomic<T *>[]> buf;
+        explicit ring(int64_t cap) : mask(cap - 1), buf(new std::atomic<T *>[cap]) {}
+        T *get(int64_t i) const { return buf[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T *x) { buf[i & mask].store(x, std::memory_order_relaxed); }
+    };
+
+    std::atomic<int64_t> top{0}, bottom{0};
+    std::atomic<ring *> array;
+    std::vector<std::unique_ptr<ring>> rings;
+
+public:
+    explicit workStealingDeque(int64_t cap = 256)
+    {
+        rings.emplace_back(new ring(cap));
+        array.store(rings.back().get(), std::memory_order_relaxed);
+    }
+    workStealingDeque(const workStealingDeque &) = delete;
+    workStealingDeque &operator=(const workStealingDeque &) = delete;
+
+    // 仅所有者调用
+    void push(T *x)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        ring *a = array.load(std::memory_order_relaxed);
+        if (b - t > a->mask)
+        {
+            ring *bigger = new ring((a->mask + 1) * 2);
+            for (int64_t i = t; i < b; i++)
+                bigger->put(i, a->get(i));
+            rings.emplace_back(bigger);
+            array.store(bigger, std::memory_order_release);
+            a = bigger;
+        }
+        a->put(b, x);
+        // release 写 bottom 发布任务内容；x86 上与 release 栅栏同样没有额外开销，且 TSan 能识别
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // 仅所有者调用，后进先出
+    T *pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        ring *a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T *x = a->get(b);
+        if (t == b)
+        {
+            // 只剩最后一个，与窃取者竞争
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                x = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return x;
+    }
+
+    // 任意线程调用，先进先出；竞争失败返回 nullptr
+    T *steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+        T *x = array.load(std::memory_order_acquire)->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return x;
+    }
+
+    bool empty() const { return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed); }
+};
+
+// 计数归零即完成的闩，等待方用 C++20 原子等待休眠。
+// 闩常放在等待方的栈上，等待方返回后立即销毁，所以计数归零还不够：countDown 在减计数之前登记、
+// notify_all 之后才注销，done / wait 要等登记数也归零才返回，保证最后一次 notify 不会碰到已释放的闩
+class completionLatch
+{
+private:
+    std::atomic<int64_t> count;
+    std::atomic<int> notifying{0}; // 正在 countDown 中的线程数
+
+public:
+    explicit completionLatch(int64_t n = 0) : count(n) {}
+    void add(int64_t n) { count.fetch_add(n, std::memory_order_relaxed); }
+    void countDown(int64_t n = 1)
+    {
+        // 登记先于减计数：读到计数归零的等待方必然也看得到这次登记
+        notifying.fetch_add(1, std::memory_order_relaxed);
+        if (count.fetch_sub(n, std::memory_order_acq_rel) == n)
+            count.notify_all();
+        // 这之后不再访问闩
+        notifying.fetch_sub(1, std::memory_order_release);
+    }
+    bool done() const
+    {
+        return count.load(std::memory_order_acquire) == 0 && notifying.load(std::memory_order_acquire) == 0;
+    }
+    void wait() const
+    {
+        int64_t c;
+        while ((c = count.load(std::memory_order_acquire)) != 0)
+            count.wait(c);
+        // 最后一个 countDown 此时最多还差 notify_all 与注销两步，自旋等它离开
+        while (notifying.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+};
+
+// 线程池里的任务：可调用对象直接构造在内联缓冲里，放不下才单独分配。
+// 执行完成后对 latch（可为空）计数减一；heap 为真的任务由执行者 delete，否则属于某个 taskArena
+struct alignas(64) poolTask
+{
+    static constexpr size_t inlineSize = 80;
+
+    void (*run)(poolTask *);
+    void (*destroy)(poolTask *);
+    completionLatch *latch = nullptr;
+    bool heap = false;
+    alignas(16) unsigned char storage[inlineSize];
+
+    template <typename F>
+    void set(F &&f)
+    {
+        using D = std::decay_t<F>;
+        if constexpr (sizeof(D) <= inlineSize && alignof(D) <= 16)
+        {
+            new (storage) D(std::forward<F>(f));
+            run = [](poolTask *t)
+            { (*std::launder(reinterpret_cast<D *>(t->storage)))(); };
+            destroy = [](poolTask *t)
+            { std::launder(reinterpret_cast<D *>(t->storage))->~D(); };
+        }
+        else
+        {
+            *reinterpret_cast<D **>(storage) = new D(std::forward<F>(f));
+            run = [](poolTask *t)
+            { (**reinterpret_cast<D **>(t->storage))(); };
+            destroy = [](poolTask *t)
+            { delete *reinterpret_cast<D **>(t->storage); };
+        }
+    }
+
+    // 先析构可调用对象、再通知 latch：等待方一旦返回就可能回收任务所在的内存。
+    // countDown 是对任务与 latch 的最后一次访问，latch 保证它通知完之前等待方不会返回
+    void execute()
+    {
+        run(this);
+        completionLatch *l = latch;
+        bool owned = heap;
+        destroy(this);
+        if (owned)
+            delete this;
+        if (l)
+            l->countDown();
+    }
+};
+
+// 按帧回收的任务内存：分配只做一次原子加，帧末 reset 一次性回收，不逐个释放。
+// 块按需分配且只增不减；超出上限时 allocate 返回 nullptr，由调用方改用堆上的任务
+class taskArena
+{
+private:
+    static constexpr size_t blockTasks = 1024, maxBlocks = 64;
+    std::atomic<size_t> used{0};
+    std::atomic<poolTask *> blocks[maxBlocks] = {};
+    std::mutex mtx;
+
+public:
+    taskArena() = default;
+    taskArena(const taskArena &) = delete;
+    taskArena &operator=(const taskArena &) = delete;
+    ~taskArena()
+    {
+        for (auto &b : blocks)
+            delete[] b.load(std::memory_order_relaxed);
+    }
+
+    // 分配 n 个连续的任务，线程安全
+    poolTask *allocate(size_t n = 1)
+    {
+        if (n > blockTasks)
+            return nullptr;
+        while (true)
+        {
+            size_t first = used.fetch_add(n, std::memory_order_relaxed);
+            size_t b = first / blockTasks;
+            if (b >= maxBlocks)
+                return nullptr;
+            // 跨块的区间作废，从下一块重新取
+            if ((first + n - 1) / blockTasks != b)
+                continue;
+            poolTask *block = blocks[b].load(std::memory_order_acquire);
+            if (!block)
+            {
+                std::lock_guard l(mtx);
+                block = blocks[b].load(std::memory_order_relaxed);
+                if (!block)
+                {
+                    block = new poolTask[blockTasks];
+                    blocks[b].store(block, std::memory_order_release);
+                }
+            }
+            return block + first % blockTasks;
+        }
+    }
+
+    // 调用方保证此时没有未执行完的任务
+    void reset() { used.store(0, std::memory_order_relaxed); }
+};
+
+// parallelFor / parallelReduce 的共享状态。参与者用原子下标自取区间，取空即退出；
+// 闩记录还没退出的辅助任务，调用方等它归零才返回，因此 job 可以放在调用方栈上
+template <typename Body>
+struct parallelJob
+{
+    static constexpr double targetNs = 50000; // 自动粒度下每块的目标耗时
+
+    Body *body;
+    size_t end, maxGrain;
+    bool autoGrain;
+    std::atomic<size_t> next, grain;
+    std::atomic<int> slots{1}; // 0 号留给调用方
+    completionLatch helpers;
+
+    parallelJob(Body &b, size_t begin, size_t end, size_t g, size_t maxG)
+        : body(&b), end(end), maxGrain(maxG), autoGrain(g == 0), next(begin), grain(g ? g : std::max<size_t>(1, maxG / 8)) {}
+
+    void work(int slot)
+    {
+        while (true)
+        {
+            size_t g = grain.load(std::memory_order_relaxed);
+            size_t lo = next.fetch_add(g, std::memory_order_relaxed);
+            if (lo >= end)
+                return;
+            size_t hi = std::min(end, lo + g);
+            auto t0 = std::chrono::steady_clock::now();
+            (*body)(lo, hi, slot);
+            if (autoGrain)
+            {
+                // 按实测的单元素耗时调整粒度，上限保证每个线程至少分到几块，便于负载均衡
+                double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+                size_t want = size_t(targetNs * (hi - lo) / std::max(ns, 1.0));
+                grain.store(std::clamp<size_t>(want, 1, maxGrain), std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+// 线程池配置：线程数、绑核与 NUMA 节点
+struct poolConfig
+{
+    int threads = 0;       // 0 表示按可用 CPU 数（给了 cpus 时取 cpus 的个数）
+    std::vector<int> cpus; // 工作线程 i 绑定到 cpus[i % cpus.size()]，为空则不绑定
+    int numaNode = -1;     // >= 0 时只用该节点上的 CPU：cpus 为空取节点全部 CPU，否则取两者交集
+};
+
+// 工作窃取线程池：每个工作线程一个 Chase-Lev 队列，空闲时随机挑选受害者窃取，
+// 先自旋一段时间再休眠。外部线程提交的任务进入共享的注入队列，工作线程一次取走一批
 class ThreadPool
 {
 private:
-    ThreadPool();
-    ThreadPool(const ThreadPool &) = delete;
-    ThreadPool &operator=(const ThreadPool &) = delete;
+    static constexpr int spinCount = 64;       // 休眠前自旋尝试的次数
+    static constexpr size_t maxInjectGrab = 64; // 工作线程一次从注入队列取走的上限
+
+    struct worker
+    {
+        workStealingDeque<poolTask> tasks;
+        uint32_t seed; // 随机挑选受害者
+    };
 
     std::vector<std::thread> pool;
-    const int threadNum = std::thread::hardware_concurrency();
+    const std::vector<int> cpus;
+    const int threadNum;
+    std::vector<std::unique_ptr<worker>> workers;
+
+    std::mutex injectMtx;
+    std::deque<poolTask *> injectQueue;
+
+    // 休眠 / 唤醒：epoch 每次唤醒加一，休眠者据此判断是否被叫醒过
     std::mutex mtx;
     std::condition_variable cv;
-    std::atomic_bool _stop;
+    std::atomic<int> sleepers{0};
+    uint64_t epoch = 0;
+    std::atomic_bool _stop{false};
+
+    static inline thread_local ThreadPool *tlsPool = nullptr;
+    static inline thread_local int tlsIndex = -1;
+
+    static std::vector<int> nodeCpus(int node);
+    static std::vector<int> resolveCpus(const poolConfig &cfg);
+    void pinThread(int idx);
+    void workerLoop(int idx);
+    poolTask *findTask(int idx);
+    void push(poolTask *t);
+    void wake(int n);
+
+    // 工作线程提交到自己的队列，其他线程提交到注入队列（只加一次锁）
+    template <typename Get>
+    void pushBatch(int n, Get get)
+    {
+        if (n <= 0)
+            return;
+        if (tlsPool == this)
+            for (int i = 0; i < n; i++)
+                workers[tlsIndex]->tasks.push(get(i));
+        else
+        {
+            std::lock_guard l(injectMtx);
+            for (int i = 0; i < n; i++)
+                injectQueue.push_back(get(i));
+        }
+    }
 
-    std::queue<std::packaged_task<void()>> taskQueue;
+    // 调用方与最多 threadNum 个辅助任务一起自取区间，直到全部完成
+    template <typename Body>
+    void runParallel(taskArena *arena, size_t begin, size_t end, size_t grain, Body &body)
+    {
+        size_t n = end - begin;
+        size_t maxGrain = std::max<size_t>(1, n / (threadNum * 4));
+        parallelJob<Body> job(body, begin, end, grain, maxGrain);
+        size_t chunks = (n + job.grain - 1) / job.grain;
+        int helpers = int(std::min<size_t>(threadNum, chunks - 1));
+        // 辅助任务取自 arena，没有 arena 或已用满时在堆上分配，等全部退出后由这里释放
+        poolTask *ts = arena && helpers ? arena->allocate(helpers) : nullptr;
+        bool heap = helpers && !ts;
+        if (heap)
+            ts = new poolTask[helpers];
+        job.helpers.add(helpers);
+        for (int i = 0; i < helpers; i++)
+        {
+            ts[i].latch = &job.helpers;
+            ts[i].set([&job]
+                      { job.work(job.slots.fetch_add(1, std::memory_order_relaxed)); });
+        }
+        pushBatch(helpers, [&](int i)
+                  { return ts + i; });
+        wake(helpers);
+        job.work(0);
+        // job 与 helpers 都在本栈帧上：辅助任务退出 work 后只剩对 helpers 的 countDown，
+        // wait 要等这些 countDown 全部离开才返回，之后才能销毁 job、释放 ts
+        wait(job.helpers);
+        if (heap)
+            delete[] ts;
+    }
+
+    template <typename F, typename... Arg>
+    auto makeTask(F &&f, Arg &&...args) -> std::pair<poolTask *, std::future<decltype(f(std::forward<Arg>(args)...))>>
+    {
+        using RetType = decltype(f(std::forward<Arg>(args)...));
+        auto ptr = std::make_shared<std::packaged_task<RetType()>>(std::bind(std::forward<F>(f), std::forward<Arg>(args)...));
+        std::future<RetType> fut = ptr->get_future();
+        poolTask *t = new poolTask;
+        t->heap = true;
+        t->set([ptr]
+               { (*ptr)(); });
+        return {t, std::move(fut)};
+    }
 
 public:
+    explicit ThreadPool(const poolConfig &cfg = {});
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
     ~ThreadPool();
+
+    // 进程级默认线程池，不显式指定线程池时使用
     static ThreadPool &getInstance()
     {
         static ThreadPool _instance;
@@ -34,45 +412,333 @@ public:
     template <typename F, typename... Arg>
     auto assign(F &&f, Arg &&...args) -> std::future<decltype(f(std::forward<Arg>(args)...))>
     {
-        using RetType = decltype(f(std::forward<Arg>(args)...));
-        auto ptr = std::make_shared<std::packaged_task<RetType()>>(std::bind(std::forward<F>(f), std::forward<Arg>(args)...));
-        std::future<RetType> fut = ptr->get_future();
-        mtx.lock();
-        taskQueue.emplace([ptr]
-                          { (*ptr)(); });
-        mtx.unlock();
-        cv.notify_one();
-        return fut;
+        auto [t, fut] = makeTask(std::forward<F>(f), std::forward<Arg>(args)...);
+        push(t);
+        wake(1);
+        return std::move(fut);
+    }
+
+    // 批量提交 f(0) ... f(n-1)：注入队列只加一次锁，唤醒也只做一次
+    template <typename F>
+    std::vector<std::future<void>> assignBulk(int n, F f)
+    {
+        std::vector<std::future<void>> futs;
+        futs.reserve(n);
+        std::vector<poolTask *> batch;
+        batch.reserve(n);
+        for (int i = 0; i < n; i++)
+        {
+            auto [t, fut] = makeTask(f, i);
+            batch.push_back(t);
+            futs.push_back(std::move(fut));
+        }
+        pushBatch(n, [&](int i)
+                  { return batch[i]; });
+        wake(n);
+        return futs;
+    }
+
+    // 不经过 future 的提交：任务取自 arena，完成后对 latch 计数减一，用 wait(latch) 等待
+    template <typename F>
+    void submit(taskArena &arena, completionLatch &latch, F &&f)
+    {
+        poolTask *t = arena.allocate();
+        if (!t)
+        {
+            t = new poolTask;
+            t->heap = true;
+        }
+        t->latch = &latch;
+        t->set(std::forward<F>(f));
+        latch.add(1);
+        push(t);
+        wake(1);
+    }
+
+    // 批量提交 f(0) ... f(n-1)，任务在 arena 中连续分配
+    template <typename F>
+    void submitBulk(taskArena &arena, completionLatch &latch, int n, F f)
+    {
+        if (n <= 0)
+            return;
+        poolTask *ts = arena.allocate(n);
+        latch.add(n);
+        auto init = [&](poolTask *t, int i)
+        {
+            t->heap = !ts;
+            t->latch = &latch;
+            t->set([f, i]
+                   { f(i); });
+            return t;
+        };
+        if (ts)
+        {
+            for (int i = 0; i < n; i++)
+                init(ts + i, i);
+            pushBatch(n, [&](int i)
+                      { return ts + i; });
+        }
+        else
+        {
+            std::vector<poolTask *> batch(n);
+            for (int i = 0; i < n; i++)
+                batch[i] = init(new poolTask, i);
+            pushBatch(n, [&](int i)
+                      { return batch[i]; });
+        }
+        wake(n);
+    }
+
+    // 等待 latch 归零；在工作线程上调用时边等边执行别的任务，嵌套等待不会占死线程
+    void wait(completionLatch &latch)
+    {
+        if (tlsPool != this)
+        {
+            latch.wait();
+            return;
+        }
+        while (!latch.done())
+        {
+            if (poolTask *t = findTask(tlsIndex))
+                t->execute();
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    // 对 [begin, end) 分块调用 fn(lo, hi)，调用线程也参与执行，返回时全部完成
+    // grain 为 0 时按实测耗时自动选择块大小；给出 arena 时辅助任务从中分配
+    template <typename F>
+    void parallelFor(taskArena *arena, size_t begin, size_t end, size_t grain, F &&fn)
+    {
+        if (begin >= end)
+            return;
+        auto body = [&](size_t lo, size_t hi, int)
+        { fn(lo, hi); };
+        runParallel(arena, begin, end, grain, body);
+    }
+
+    template <typename F>
+    void parallelFor(size_t begin, size_t end, size_t grain, F &&fn)
+    {
+        parallelFor(nullptr, begin, end, grain, std::forward<F>(fn));
+    }
+
+    // 每个参与者用 acc = fn(lo, hi, acc) 累积自己的部分结果，最后按参与者顺序用 reduce 合并
+    template <typename T, typename F, typename R>
+    T parallelReduce(taskArena *arena, size_t begin, size_t end, size_t grain, T identity, F &&fn, R &&reduce)
+    {
+        std::vector<T> partial(threadNum + 1, identity);
+        auto body = [&](size_t lo, size_t hi, int slot)
+        { partial[slot] = fn(lo, hi, partial[slot]); };
+        if (begin < end)
+            runParallel(arena, begin, end, grain, body);
+        T res = identity;
+        for (auto &p : partial)
+            res = reduce(res, p);
+        return res;
+    }
+
+    template <typename T, typename F, typename R>
+    T parallelReduce(size_t begin, size_t end, size_t grain, T identity, F &&fn, R &&reduce)
+    {
+        return parallelReduce(nullptr, begin, end, grain, identity, std::forward<F>(fn), std::forward<R>(reduce));
     }
 };
 
-inline ThreadPool::ThreadPool()
+// 读取 /sys 下的 cpulist（如 "0-3,8-11"），不依赖 libnuma；读不到时返回空
+inline std::vector<int> ThreadPool::nodeCpus(int node)
+{
+    std::vector<int> res;
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+        int lo, hi;
+        char dash;
+        std::istringstream ss(item);
+        if (!(ss >> lo))
+            continue;
+        if (!(ss >> dash >> hi))
+            hi = lo;
+        for (int c = lo; c <= hi; c++)
+            res.push_back(c);
+    }
+    return res;
+}
+
+inline std::vector<int> ThreadPool::resolveCpus(const poolConfig &cfg)
+{
+    if (cfg.numaNode < 0)
+        return cfg.cpus;
+    std::vector<int> node = nodeCpus(cfg.numaNode);
+    if (node.empty())
+    {
+        std::cerr << "ThreadPool: NUMA node " << cfg.numaNode << " not found, ignored\n";
+        return cfg.cpus;
+    }
+    if (cfg.cpus.empty())
+        return node;
+    std::vector<int> res;
+    for (int c : cfg.cpus)
+        if (std::find(node.begin(), node.end(), c) != node.end())
+            res.push_back(c);
+    return res;
+}
+
+inline void ThreadPool::pinThread(int idx)
+{
+    if (cpus.empty())
+        return;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[idx % cpus.size()], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+        std::cerr << "ThreadPool: failed to pin worker " << idx << " to cpu " << cpus[idx % cpus.size()] << '\n';
+#endif
+}
+
+inline ThreadPool::ThreadPool(const poolConfig &cfg)
+    : cpus(resolveCpus(cfg)),
+      threadNum(cfg.threads > 0 ? cfg.threads : cpus.empty() ? std::max(1, int(std::thread::hardware_concurrency())) : int(cpus.size()))
 {
     for (int i = 0; i < threadNum; i++)
     {
-        pool.emplace_back([this]
-                          {
-            std::unique_lock l(mtx,std::defer_lock);
-            std::packaged_task<void()> t;
-            while (true)
-            {
-                l.lock();
-                cv.wait(l,[this]{return _stop.load() || !taskQueue.empty();});
-                if (taskQueue.empty())
-                    return;
-                t = move(taskQueue.front());
-                taskQueue.pop();
-                l.unlock();
-                t();
-            } });
+        workers.emplace_back(new worker);
+        workers.back()->seed = 2654435761u * (i + 1);
     }
+    for (int i = 0; i < threadNum; i++)
+        pool.emplace_back(&ThreadPool::workerLoop, this, i);
 }
 
 inline ThreadPool::~ThreadPool()
 {
-    _stop = true;
+    {
+        std::lock_guard l(mtx);
+        _stop = true;
+        epoch++;
+    }
     cv.notify_all();
     for (auto &t : pool)
         if (t.joinable())
             t.join();
 }
+
+// 工作线程提交到自己的队列，其他线程提交到注入队列
+inline void ThreadPool::push(poolTask *t)
+{
+    if (tlsPool == this)
+        workers[tlsIndex]->tasks.push(t);
+    else
+    {
+        std::lock_guard l(injectMtx);
+        injectQueue.push_back(t);
+    }
+}
+
+inline void ThreadPool::wake(int n)
+{
+    // 与休眠前的 sleepers++ 配对：要么提交者看到有人休眠，要么休眠者复查时看到任务
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_seq_cst) == 0)
+        return;
+    {
+        std::lock_guard l(mtx);
+        epoch++;
+    }
+    if (n == 1)
+        cv.notify_one();
+    else
+        cv.notify_all();
+}
+
+inline poolTask *ThreadPool::findTask(int idx)
+{
+    worker &self = *workers[idx];
+    if (poolTask *t = self.tasks.pop())
+        return t;
+
+    // 注入队列一次取走一批，多出来的放进自己的队列供其他线程窃取
+    {
+        std::unique_lock l(injectMtx, std::try_to_lock);
+        if (l.owns_lock() && !injectQueue.empty())
+        {
+            size_t grab = std::min(maxInjectGrab, std::max<size_t>(1, injectQueue.size() / threadNum));
+            poolTask *first = injectQueue.front();
+            injectQueue.pop_front();
+            for (size_t i = 1; i < grab; i++)
+            {
+                self.tasks.push(injectQueue.front());
+                injectQueue.pop_front();
+            }
+            return first;
+        }
+    }
+
+    // 从随机位置开始把其他工作线程各看一遍：起点随机分散窃取者，一遍不漏保证休眠前的复查不会错过有任务的队列
+    if (threadNum < 2)
+        return nullptr;
+    self.seed ^= self.seed << 13;
+    self.seed ^= self.seed >> 17;
+    self.seed ^= self.seed << 5;
+    int start = int(self.seed % uint32_t(threadNum - 1));
+    for (int i = 0; i < threadNum - 1; i++)
+    {
+        int victim = (idx + 1 + (start + i) % (threadNum - 1)) % threadNum;
+        if (poolTask *t = workers[victim]->tasks.steal())
+            return t;
+    }
+    return nullptr;
+}
+
+inline void ThreadPool::workerLoop(int idx)
+{
+    pinThread(idx);
+    tlsPool = this;
+    tlsIndex = idx;
+    while (true)
+    {
+        poolTask *t = nullptr;
+        for (int spin = 0; spin < spinCount && !t; spin++)
+        {
+            t = findTask(idx);
+            if (!t)
+                std::this_thread::yield();
+        }
+        if (!t)
+        {
+            std::unique_lock l(mtx);
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            uint64_t seen = epoch;
+            l.unlock();
+            // 休眠前复查，注入队列这次要阻塞加锁，避免 try_lock 失败漏掉任务
+            {
+                std::lock_guard il(injectMtx);
+                if (!injectQueue.empty())
+                {
+                    t = injectQueue.front();
+                    injectQueue.pop_front();
+                }
+            }
+            if (!t)
+                t = findTask(idx);
+            l.lock();
+            if (!t)
+            {
+                if (_stop)
+                {
+                    sleepers.fetch_sub(1, std::memory_order_seq_cst);
+                    return;
+                }
+                cv.wait(l, [&]
+                        { return epoch != seen || _stop; });
+            }
+            sleepers.fetch_sub(1, std::memory_order_seq_cst);
+            l.unlock();
+            if (!t)
+                continue;
+        }
+        t->execute();
+    }
+}
@@ -3,38 +3,44 @@
 #include <optional>
 #include <array>
 
-class Triangle
+template <typename T>
+class TriangleT
 {
     friend class rasterizer;
+    friend class model;
 
 private:
     int colorR[3];
     int colorG[3];
     int colorB[3];
 
-    std::optional<vec3> normal[3];
-    double uTex[3], vTex[3];
-    Point ver[3];
+    std::optional<vec3T<T>> normal[3];
+    T uTex[3], vTex[3];
+    PointT<T> ver[3];
 
     void initColor();
 
 public:
-    Triangle(std::initializer_list<Point> list);
-    Triangle() { initColor(); }
+    TriangleT(std::initializer_list<PointT<T>> list);
+    TriangleT() { initColor(); }
 
-    Triangle &operator=(std::initializer_list<Point> list);
+    TriangleT &operator=(std::initializer_list<PointT<T>> list);
 
     void printData();
 
     bool inside(double x, double y);
 
-    Triangle normalize();
+    TriangleT normalize();
+    // 以本三角形的重心坐标 weight[i] 给出三个顶点，插值出子三角形的位置与顶点属性
+    TriangleT subTriangle(const double (*weight)[3]) const;
 
-    void setVertex(vec3 p, int idx);
+    void setVertex(vec3T<T> p, int idx);
     void setColor(int r, int g, int b, int idx = -1);
-    void setNormal(vec3 n, int idx);
+    void setNormal(vec3T<T> n, int idx);
     void setTexCoord(double u, double v, int idx);
 
-    Point &getVertex(int idx) { return ver[idx]; }
-    const Point& getVertex(int idx) const {return ver[idx];}
+    PointT<T> &getVertex(int idx) { return ver[idx]; }
+    const PointT<T> &getVertex(int idx) const { return ver[idx]; }
 };
+
+using Triangle = TriangleT<real>;
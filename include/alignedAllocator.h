@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// 按 SIMD 宽度对齐的分配器，顶点等 SoA 数组可直接用对齐加载
+template <class T, std::size_t align = 64>
+struct alignedAllocator
+{
+    using value_type = T;
+    template <class U>
+    struct rebind
+    {
+        using other = alignedAllocator<U, align>;
+    };
+
+    alignedAllocator() = default;
+    template <class U>
+    alignedAllocator(const alignedAllocator<U, align> &) {}
+
+    T *allocate(std::size_t n) { return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(align))); }
+    void deallocate(T *p, std::size_t) { ::operator delete(p, std::align_val_t(align)); }
+
+    template <class U>
+    bool operator==(const alignedAllocator<U, align> &) const { return true; }
+};
+
+template <class T>
+using alignedVector = std::vector<T, alignedAllocator<T>>;
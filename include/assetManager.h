@@ -0,0 +1,87 @@
+#pragma once
+#include "model.h"
+#include "objLoader.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class assetState
+{
+    pending, // 排队中
+    loading, // 至少一个作业已开始
+    ready,   // 网格与纹理都已载入，此后 geometry 只读
+    failed,  // 网格载入失败或任一作业抛出异常，不会被绘制
+};
+
+// 异步载入的模型。后台线程只写 geometry 的顶点、下标与纹理，状态变为 ready 之前其他线程不读它；
+// modelMatrix / cull 属于调用方，随时可改，rasterizer 提交帧时取快照
+class modelAsset
+{
+private:
+    friend class assetManager;
+    friend class rasterizer;
+
+    model geometry;
+    std::atomic<assetState> state{assetState::pending};
+    std::atomic<int> remaining{0}; // 尚未完成的作业数（网格、纹理各一个）
+    std::atomic<bool> loadFailed{false};
+    std::atomic<float> priority{0}; // 估计的屏幕半径（像素），rasterizer 每帧更新，越大越先载入
+    std::string objPath, texturePath;
+    meshBounds estimate{}; // 载入前估计的包围体（模型空间），用于排优先级与摆放占位模型
+    bool analyze = false;  // 载入时统计网格优化前后的指标，结果写进 analysis
+    meshAnalysis analysis{};
+
+public:
+    Matrix modelMatrix = Matrix::identity();
+    cullMode cull = cullMode::back;
+
+    assetState getState() const { return state.load(std::memory_order_acquire); }
+    bool ready() const { return getState() == assetState::ready; }
+    // 就绪后只读访问载入的模型，之前返回 nullptr
+    const model *get() const { return ready() ? &geometry : nullptr; }
+    // 就绪且载入时要求了统计才有结果
+    const meshAnalysis *getAnalysis() const { return ready() && analyze ? &analysis : nullptr; }
+    void translate(vec3 v) { modelMatrix *= model::translation(v); }
+    void rotate(double deg, vec3 r) { modelMatrix *= model::rotation(deg, r); }
+    void scale(vec3 v) { modelMatrix *= model::scaling(v); }
+};
+
+using modelHandle = std::shared_ptr<modelAsset>;
+
+// 异步资源管理：网格载入与纹理解码在自己的线程池上进行，不占用渲染线程池的队列。
+// 每个模型拆成网格、纹理两个作业，线程空闲时取当前优先级最高的作业，同优先级先到先做
+class assetManager
+{
+private:
+    struct job
+    {
+        modelHandle asset;
+        bool texture;
+        uint64_t seq;
+    };
+
+    std::mutex mtx;
+    std::vector<job> queue; // 尚未开始的作业
+    uint64_t nextSeq = 0;
+    completionLatch running; // 已提交、尚未结束的作业
+    taskArena tasks;         // 作业任务的内存，running 归零时才回收
+    ThreadPool pool;         // 放在最后，最先析构：工作线程全部退出后才释放上面的成员
+
+    void runNext();
+
+public:
+    explicit assetManager(int threads = 2);
+    ~assetManager(); // 丢弃尚未开始的作业，等正在进行的完成
+    assetManager(const assetManager &) = delete;
+    assetManager &operator=(const assetManager &) = delete;
+
+    // 立即返回句柄。radiusHint 为模型空间包围球半径的估计，存在有效网格缓存时改用缓存中的实际包围体。
+    // analyze 为真时在载入线程上统计优化前后的网格指标（绕过缓存、重新解析 OBJ），见 modelAsset::getAnalysis
+    modelHandle loadModel(const std::string &objPath, const std::string &texturePath = {}, float radiusHint = 1,
+                          bool analyze = false);
+    // 等待所有已提交的作业完成
+    void waitAll();
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+// 热点内核可用的指令集级别，从低到高
+enum class simdLevel
+{
+    scalar,
+    sse4,   // SSE4.2
+    avx2,   // AVX2 + FMA
+    avx512, // AVX-512 F/DQ
+};
+
+// 启动时用 cpuid 检测一次，所有多版本内核按 level() 选择实现
+// 环境变量 RASTERIZER_SIMD=scalar|sse4|avx2|avx512 或 setLevel() 可强制降级，便于基准对比
+class cpuFeature
+{
+private:
+    static simdLevel &current();
+
+public:
+    static simdLevel detected();
+    static simdLevel level() { return current(); }
+    // 不能超过 detected()，否则回退到检测到的级别；应在渲染开始前调用
+    static void setLevel(simdLevel l);
+    static const char *name(simdLevel l);
+};
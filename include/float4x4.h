@@ -0,0 +1,30 @@
+#pragma once
+#include "Matrix.h"
+#include <span>
+
+// 齐次坐标，一个顶点正好装满一个 SSE 寄存器；点 w = 1，方向 w = 0
+struct alignas(16) vec4
+{
+    float x, y, z, w;
+};
+
+// 单精度 4x4 行主序矩阵，供顶点阶段批量变换用；每行 16 字节对齐，可直接按行装入寄存器
+struct alignas(16) float4x4
+{
+    float m[4][4];
+
+    float4x4() : m{} {}
+    explicit float4x4(Matrix mat);
+    static float4x4 identity();
+
+    float4x4 operator*(const float4x4 &b) const;
+    vec4 operator*(const vec4 &v) const;
+    float4x4 transpose() const;
+    // 仿射矩阵 [A t; 0 1] 的逆 [A^-1  -A^-1 t; 0 1]，只需 3x3 余子式，不走通用消元
+    float4x4 affineInverse() const;
+    // 法线矩阵：左上 3x3 的逆转置，非均匀缩放下变换后的法线仍与表面垂直；平移列为 0
+    float4x4 normalMatrix() const;
+};
+
+// out[i] = m * in[i]，按 cpuFeature::level() 选择内核；out 至少与 in 等长，可以与 in 是同一块内存
+void transformPoints(const float4x4 &m, std::span<const vec4> in, std::span<vec4> out);
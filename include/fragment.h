@@ -0,0 +1,29 @@
+#pragma once
+
+// 一组片元的 SoA 数据，供纹理采样与光照按 SIMD 宽度批量处理
+struct fragmentBatch
+{
+    static constexpr int maxCount = 16;
+    int count = 0;
+    alignas(64) float pos[3][maxCount]; // 观察空间坐标
+    alignas(64) float nor[3][maxCount];
+    alignas(64) float u[maxCount];
+    alignas(64) float v[maxCount];
+    alignas(64) float color[3][maxCount]; // 输入为基础颜色，着色后为最终颜色
+
+    // 把 from 通道的输入复制到 [begin, end)，批次凑不满向量宽度时用来填充末尾
+    void replicateLane(int from, int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                pos[c][i] = pos[c][from];
+                nor[c][i] = nor[c][from];
+                color[c][i] = color[c][from];
+            }
+            u[i] = u[from];
+            v[i] = v[from];
+        }
+    }
+};
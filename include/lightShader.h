@@ -1,15 +1,19 @@
 #pragma once
 #include "vec.h"
+#include "fragment.h"
 #include <vector>
 
 class lightShader
 {
 public:
-    double I, Ia, p;
+    static constexpr real specularFloor = -80; // 高光项 ln 值的下限，低于它按 0 计
+    real I, Ia, p;
     vec3 ks, ka;
     std::vector<vec3> lightPos;
 
     lightShader();
 
     vec3 operator()(vec3 xyz, vec3 normal, vec3 color, vec3 view_pos);
+    // 批量 Blinn-Phong，原地把 batch.color 替换为着色结果
+    void operator()(fragmentBatch &batch, vec3 view_pos);
 };
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+// 只读内存映射整个文件，内容直接在映射上读取，不经过 read 拷贝；析构时解除映射
+class mappedFile
+{
+private:
+    const char *ptr = nullptr;
+    size_t len = 0;
+    bool opened = false;
+#ifdef _WIN32
+    void *file = nullptr, *mapping = nullptr;
+#endif
+
+public:
+    mappedFile() = default;
+    explicit mappedFile(const char *path) { open(path); }
+    ~mappedFile() { close(); }
+    mappedFile(const mappedFile &) = delete;
+    mappedFile &operator=(const mappedFile &) = delete;
+
+    // 失败返回 false；空文件也算打开成功，此时 size() 为 0
+    bool open(const char *path);
+    void close();
+    bool isOpen() const { return opened; }
+    const char *data() const { return ptr; }
+    size_t size() const { return len; }
+    std::string_view view() const { return {ptr, len}; }
+};
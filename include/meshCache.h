@@ -0,0 +1,27 @@
+#pragma once
+#include "model.h"
+#include "objLoader.h"
+#include <string>
+#include <vector>
+
+// 二进制网格缓存，写在源 OBJ 旁边（name.obj.mesh）。文件布局：
+//   header | 各顶点流与下标缓冲（16 或 32 位，每段 64 字节对齐）| 网格表 | 字符串表
+// 载入时整体内存映射，model 的顶点流与下标直接指向映射，不做任何拷贝；
+// 版本号、字节序或源文件的大小 / 修改时间对不上都视为缓存失效
+class meshCache
+{
+public:
+    static constexpr uint32_t version = 3;
+
+    static std::string pathFor(const char *objPath);
+    // 缓存有效时映射进来；verts / indices 指向映射，映射随它们一起释放。
+    // 下标不拷贝就直接使用，所以载入时在 pool 上并行扫一遍，有越界下标的缓存视为无效
+    static bool load(const char *objPath, vertexBuffer &verts, indexBuffer &indices,
+                     std::vector<objMesh> &meshes, std::string &materialLib, meshBounds &bounds,
+                     ThreadPool &pool = ThreadPool::getInstance());
+    // 只读缓存头中整个模型的包围体，不映射整个文件；缓存无效时返回 false
+    static bool peekBounds(const char *objPath, meshBounds &bounds);
+    // 先写临时文件再改名，读者不会看到写了一半的缓存；目录不可写等失败时返回 false
+    static bool save(const char *objPath, const vertexBuffer &verts, const indexBuffer &indices,
+                     const std::vector<objMesh> &meshes, const std::string &materialLib);
+};
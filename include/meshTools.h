@@ -0,0 +1,23 @@
+#pragma once
+#include "model.h"
+#include "objLoader.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <vector>
+
+// 顶点焊接：位置、法线、纹理坐标与颜色逐位相同（+0 与 -0 视为相同）的顶点合并为一个，
+// 保留第一次出现的那个，合并后的顶点按第一次出现的顺序重新编号，并改写 indices。
+// 按顶点哈希分区后各分区在线程池上并行去重，结果与线程数无关；返回合并后的顶点数
+size_t weldVertices(vertexBuffer &verts, alignedVector<uint32_t> &indices, ThreadPool &pool = ThreadPool::getInstance());
+
+// 网格优化，依次做三步：
+//   1. 顶点缓存：Forsyth 线性时间算法，按模拟 LRU 缓存中的位置与顶点剩余三角形数打分，贪心选下一个三角形；
+//   2. 过度绘制：把上一步的序列在缓存命中中断处切成簇（Sander 等的做法，簇内 ACMR 不超过整段的 1.05 倍），
+//      簇按 (簇质心 - 网格质心)·簇法线 从大到小排列，朝外的簇先画，与视角无关；
+//   3. 顶点读取：顶点按在下标中第一次出现的顺序重排，未被引用的顶点排在最后。
+// meshes 给出时只在每段内部重排三角形（各段仍占原来的下标区间），各段在线程池上并行；为空时整个下标缓冲视为一段
+void optimizeMesh(vertexBuffer &verts, alignedVector<uint32_t> &indices, const std::vector<objMesh> &meshes = {},
+                  ThreadPool &pool = ThreadPool::getInstance());
+
+// 统计 ACMR / ATVR 与过度绘制；过度绘制用 256x256 的软件光栅在六个轴向视图上按提交顺序测得
+meshStats analyzeMesh(const vertexBuffer &verts, const indexBuffer &indices, ThreadPool &pool = ThreadPool::getInstance());
@@ -2,34 +2,196 @@
 #include "Triangle.h"
 #include "vec.h"
 #include "Matrix.h"
+#include "float4x4.h"
+#include "fragment.h"
+#include "alignedAllocator.h"
+#include "ThreadPool.h"
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_STATIC
 #include "stb_image.h"
 #include <vector>
+#include <optional>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+enum class cullMode
+{
+    none,
+    back,  // 剔除背面（屏幕上顺时针）
+    front, // 剔除正面（屏幕上逆时针）
+};
+
+// 网格数组：平时拥有自己的对齐存储；从网格缓存载入时直接指向内存映射（backing 保证映射存活），
+// 只读访问不拷贝，第一次 edit() 时才复制出一份自己的
+template <class T>
+class meshStream
+{
+private:
+    alignedVector<T> own;
+    const T *view = nullptr;
+    size_t viewSize = 0;
+    std::shared_ptr<const void> backing;
+
+public:
+    meshStream() = default;
+    meshStream(alignedVector<T> v) : own(std::move(v)) {}
+
+    void attach(const T *p, size_t n, std::shared_ptr<const void> keep)
+    {
+        own = {};
+        view = p;
+        viewSize = n;
+        backing = std::move(keep);
+    }
+    alignedVector<T> &edit()
+    {
+        if (view)
+        {
+            own.assign(view, view + viewSize);
+            view = nullptr;
+            viewSize = 0;
+            backing.reset();
+        }
+        return own;
+    }
+    bool mapped() const { return view != nullptr; }
+    const T *data() const { return view ? view : own.data(); }
+    size_t size() const { return view ? viewSize : own.size(); }
+    const T &operator[](size_t i) const { return data()[i]; }
+    const T *begin() const { return data(); }
+    const T *end() const { return data() + size(); }
+    void push_back(const T &x) { edit().push_back(x); }
+};
+
+// 顶点缓冲：位置与法线存成 vec4 数组，整个模型可一次交给 transformPoints；其余属性 SoA，装配时才按下标读取
+struct vertexBuffer
+{
+    meshStream<vec4> pos; // w = 1
+    meshStream<vec4> nor; // w = 0；没有法线的顶点存 0 向量，光栅化时改用面法线
+    meshStream<float> u, v;
+    meshStream<uint8_t> r, g, b;
+    size_t size() const { return pos.size(); }
+};
+
+// 下标缓冲：顶点数不超过 65536 时 compact() 改用 16 位存储，i16 / i32 同一时刻只有一个非空
+struct indexBuffer
+{
+    meshStream<uint32_t> i32;
+    meshStream<uint16_t> i16;
+
+    size_t size() const { return i16.size() ? i16.size() : i32.size(); }
+    uint32_t operator[](size_t i) const { return i16.size() ? i16[i] : i32[i]; }
+    // 取三角形 t 的三个下标
+    void triangle(size_t t, uint32_t *idx) const
+    {
+        if (const uint16_t *p = i16.data(); i16.size())
+            idx[0] = p[t * 3], idx[1] = p[t * 3 + 1], idx[2] = p[t * 3 + 2];
+        else
+        {
+            const uint32_t *q = i32.data();
+            idx[0] = q[t * 3], idx[1] = q[t * 3 + 1], idx[2] = q[t * 3 + 2];
+        }
+    }
+    // 取得可写的 32 位下标，当前是 16 位时先放宽
+    alignedVector<uint32_t> &edit32()
+    {
+        if (i16.size())
+        {
+            i32 = alignedVector<uint32_t>(i16.begin(), i16.end());
+            i16 = {};
+        }
+        return i32.edit();
+    }
+    void compact(size_t vertexCount)
+    {
+        if (!i32.size() || vertexCount > 65536)
+            return;
+        i16 = alignedVector<uint16_t>(i32.begin(), i32.end());
+        i32 = {};
+    }
+};
+
+// 包围体：轴对齐包围盒与包围球，球心取盒中心
+struct meshBounds
+{
+    float lo[3], hi[3];
+    float center[3], radius;
+};
+
+// OBJ 中按 o / g / usemtl 切开的一段三角形，占 indices 的 [firstIndex, firstIndex + indexCount)
+struct objMesh
+{
+    std::string name;
+    std::string material;
+    uint32_t firstIndex = 0, indexCount = 0;
+    meshBounds bounds{};
+};
+
+// 网格质量统计，见 analyzeMesh
+struct meshStats
+{
+    double acmr;     // 每个三角形的平均顶点缓存未命中数（16 项 FIFO），0.5 左右已接近最优，3 为最差
+    double atvr;     // 未命中数 / 被引用的顶点数，1 为最优
+    double overdraw; // 沿六个轴向正交投影、剔除背面后，通过深度测试的片元数 / 覆盖的像素数
+};
+
+// loadObj 焊接与重排前后的网格统计
+struct meshAnalysis
+{
+    meshStats before, after;
+};
 
 class model
 {
 private:
-    std::vector<Triangle> tris;
+    vertexBuffer verts;
+    indexBuffer indices; // 每三个下标构成一个三角形
+    std::vector<objMesh> meshes; // loadObj 载入的各段在 indices 中的区间，addTriangle 追加的三角形不属于任何一段
+    std::string materialLib;
+    meshBounds bounds{}; // 全部顶点的包围体，loadObj 时更新
     std::vector<std::pair<Point,Point>> lines;
-    unsigned char* pTextureData = nullptr;
+    unsigned char* pTextureData = nullptr; // RGBA，每个纹素 4 字节，便于 SIMD gather
     int texWidth,texHeight;
     friend class rasterizer;
 
-    vec3 getTexColor (double u,double v) const;
+    vec3 getTexColor (real u,real v) const;
+    void getTexColor(fragmentBatch &batch) const;
 public:
     Matrix modelMatrix;
+    cullMode cull = cullMode::back;
     model() { modelMatrix = Matrix::identity(); }
 
-    void addTriangle(const Triangle &t);
+    uint32_t addVertex(vec3 pos, std::optional<vec3> nor = {}, double u = 0, double v = 0, vec3 color = {255, 255, 255});
+    void addTriangle(uint32_t a, uint32_t b, uint32_t c);
+    void addTriangle(const Triangle &t); // 兼容旧接口：三个顶点各自追加，不共享
     void addLine(const Point& start,const Point& end);
 
     model translate(vec3 v);
     model rotate(double deg, vec3 r);
     model scale(vec3 v);
-    Triangle &getTriangle(int idx) { return tris[idx]; }
+    // 上面三个变换右乘到 modelMatrix 的矩阵
+    static Matrix translation(vec3 v);
+    static Matrix rotation(double deg, vec3 r);
+    static Matrix scaling(vec3 v);
+    uint32_t vertexCount() const { return uint32_t(verts.size()); }
+    int triangleCount() const { return int(indices.size() / 3); }
+    Triangle getTriangle(int idx) const; // 由顶点缓冲组装
+    const std::vector<objMesh> &getMeshes() const { return meshes; }
+    const std::string &getMaterialLib() const { return materialLib; }
+    const meshBounds &getBounds() const { return bounds; }
+    void setColor(int r, int g, int b);
+    // 合并属性完全相同的顶点并改写下标，顶点数不超过 65536 时下标改存 16 位；返回合并后的顶点数
+    size_t weld(ThreadPool &pool = ThreadPool::getInstance());
+    // 重排三角形与顶点以提高顶点缓存命中、减少过度绘制，见 optimizeMesh；三角形只在各段内部重排
+    void optimize(ThreadPool &pool = ThreadPool::getInstance());
+    meshStats analyze(ThreadPool &pool = ThreadPool::getInstance()) const;
 
     void loadTexture(const char* name);
+    // 追加 OBJ 中的全部三角形，文件无法打开时返回 false。useCache 时优先映射旁边的二进制缓存，
+    // 缓存缺失或过期则解析 OBJ 后重写缓存。给出 analysis 时总是解析 OBJ，并统计焊接与重排前后的网格
+    bool loadObj(const char *name, bool useCache = true, ThreadPool &pool = ThreadPool::getInstance(),
+                 meshAnalysis *analysis = nullptr);
     static model cube(bool frame = false);
     static model plain(bool frame = false);
 };
\ No newline at end of file
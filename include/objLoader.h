@@ -0,0 +1,75 @@
+#pragma once
+#include "model.h"
+#include "ThreadPool.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// idx 为空时统计 pos[0, count)，否则统计 idx[0, count) 引用的顶点
+meshBounds computeBounds(const vec4 *pos, const uint32_t *idx, size_t count);
+
+// OBJ 读取：文件整体内存映射，在映射上用 string_view + from_chars 原地解析，逐行不分配内存。
+// 每个不同的 v/vt/vn 组合生成一个顶点，多边形按扇形拆成三角形，结果就是 model 使用的带下标 SoA 顶点缓冲。
+// 大文件按行切块，在线程池上并行解析；下标换算、去重与输出也都按块或按位置分区并行，结果与逐行顺序解析一致
+class objLoader
+{
+private:
+    struct texCoord
+    {
+        float u, v;
+    };
+    // 面顶点的 v / vt / vn 下标。解析时正下标记为 0 起的绝对下标，负下标记为相对本块起点的偏移并置 relative 位，
+    // 各块起点由前缀和求出后统一换算成绝对下标；缺省为 -1，非法为 -2
+    struct rawCorner
+    {
+        int32_t idx[3];
+        uint8_t relative;
+    };
+    struct groupEvent
+    {
+        uint32_t face; // 事件发生前本块已解析的面数
+        bool material; // usemtl 为真，o / g 为假
+        std::string_view name;
+        uint32_t offset; // 输出阶段填入：事件发生时 indices 的长度
+    };
+    // 一个按行对齐的文件块，解析结果先存在块内，等所有块完成后再合并
+    struct chunk
+    {
+        std::string_view text;
+        std::vector<vec4> positions, normals;
+        std::vector<texCoord> texCoords;
+        std::vector<rawCorner> corners;
+        std::vector<uint32_t> faceSize; // 每个面的顶点数
+        std::vector<groupEvent> groups;
+        std::string_view materialLib;
+        size_t posBase, texBase, norBase, cornerBase; // 本块之前各类元素的总数
+        size_t cornerCount;
+        std::vector<size_t> partCursor;                // 本块的面顶点在各位置分区中的写入位置
+        size_t vertBase, vertCount, triBase, triCount;
+    };
+
+    std::vector<vec4> positions, normals;
+    std::vector<texCoord> texCoords;
+    std::vector<rawCorner> corners; // 所有块的面顶点，下标已换算成绝对下标
+    // 去重：按位置下标分区，同一位置的代表面顶点用 bucket / link 串成链表，canon 指向每个面顶点的代表
+    std::vector<uint32_t> order, bucket, link, canon;
+
+    static void parseChunk(chunk &c);
+    static void parseLine(chunk &c, std::string_view line);
+    static void parseFace(chunk &c, std::string_view rest);
+    void resolveChunk(chunk &c, size_t partSize, size_t parts);
+    void dedupPartition(size_t begin, size_t end);
+    void emitVertices(chunk &c);
+    void emitIndices(chunk &c);
+    void buildMeshes(std::vector<chunk> &chunks);
+
+public:
+    vertexBuffer verts;
+    alignedVector<uint32_t> indices;
+    std::vector<objMesh> meshes;
+    std::string materialLib; // mtllib 引用的文件名，材质本身不在这里解析
+
+    // 文件无法打开或顶点数超出 32 位下标时返回 false；无法识别的行与含非法下标的面被跳过
+    bool load(const char *path, ThreadPool &pool = ThreadPool::getInstance());
+};
@@ -1,40 +1,268 @@
 #pragma once
 #include "Matrix.h"
+#include "float4x4.h"
 #include "model.h"
+#include "assetManager.h"
 #include "vec.h"
 #include "camera.h"
 #include "lightShader.h"
 #include "ThreadPool.h"
+#include "taskGraph.h"
+#include "cpuFeature.h"
 #include <functional>
-#include <atomic>
+#include <algorithm>
 #include <span>
+#include <memory>
+
+enum class rasterizeMode
+{
+    scanLine,     // 逐列求交 + 逐像素重心坐标
+    edgeFunction, // 半平面边函数增量遍历
+};
+
+enum class renderPipeline
+{
+    forward,      // 光栅化时立即着色
+    visibility,   // 光栅化只写深度与三角形编号，之后每个像素只着色一次
+    depthPrepass, // 先只写深度，再用相等深度测试只给可见片元着色
+};
+
+// 片元阶段通过深度测试后要做的事，由 renderPipeline 决定
+enum class fragmentPass
+{
+    shade,
+    visibility,
+    depthOnly,  // 只插值并写入深度
+    depthEqual, // 深度与已写入值相等才着色，不改写深度
+};
+
+// 每帧统计，由各块的局部计数汇总
+struct renderStats
+{
+    uint64_t depthPassed = 0;         // 通过深度测试的片元，前向渲染下每个都会着色
+    uint64_t shaded = 0;              // 实际执行的着色次数
+    uint64_t coveredPixels = 0;       // 被几何覆盖的像素
+    uint64_t culled = 0;              // 光栅化前剔除的背面 / 零面积三角形
+    uint64_t clipped = 0;             // 与近 / 远平面或保护带相交被裁剪、或完全在其外被丢弃的三角形
+    uint64_t transformedVertices = 0; // 顶点阶段变换的顶点数，等于各模型唯一顶点数之和
+    void operator+=(const renderStats &s);
+    double shadedPerPixel() const { return coveredPixels ? double(shaded) / coveredPixels : 0; }
+    // 相对前向渲染，每个像素省下的着色次数
+    double savedPerPixel() const { return coveredPixels ? double(depthPassed - shaded) / coveredPixels : 0; }
+};
+
+// 顶点阶段的输出，每帧每个唯一顶点一份，按属性各成一个 vec4 数组，装配阶段按下标取用
+struct vertexStream
+{
+    alignedVector<vec4> clip;   // 裁剪空间（已含视口变换，未做透视除法）
+    alignedVector<vec4> screen; // 透视除法后的屏幕坐标
+    alignedVector<vec4> view;   // 观察空间坐标
+    alignedVector<vec4> nor;    // 观察空间法线，未归一化；0 向量表示顶点没有法线
+    void resize(size_t n)
+    {
+        clip.resize(n);
+        screen.resize(n);
+        view.resize(n);
+        nor.resize(n);
+    }
+};
+
+// 模型本帧的变换，提交时算好一次，顶点阶段与线框绘制共用
+struct modelTransform
+{
+    float4x4 mvpv, mv;
+    float4x4 normal; // mv 的法线矩阵
+    cullMode cull;
+};
+
+// 经过顶点变换、等待光栅化的三角形
+struct rasterTriangle
+{
+    Triangle tri;  // 屏幕空间
+    Triangle ctri; // 观察空间
+    const model *mod;
+    int minX, maxX, minY, maxY; // 包围盒 [min, max)
+    float minZ;                 // 最近顶点的深度，用于分层 Z 剔除
+};
+
+// 一帧从顶点变换到写回帧缓冲所需的全部私有状态，流水线模式下相邻两帧各用一份
+struct frameContext
+{
+    int width = 0, height = 0; // 缓冲的当前尺寸，与光栅化尺寸不符时本帧先重建
+    float4x4 vpv, view;        // 提交时的相机快照，帧在飞行中相机可以继续移动
+    vec3 eye;
+    renderStats stats;
+    std::vector<renderStats> tileStats;
+    std::vector<float> zBuffer;
+    std::vector<uint32_t> frameBuffer;
+    vertexStream vertexOut;
+    std::vector<const model *> drawList; // 本帧实际绘制的模型，提交时确定：未就绪的资源跳过或换成占位模型
+    std::vector<size_t> vertexBase;      // 各模型在 vertexOut 中的起始下标
+    std::vector<modelTransform> modelMats;
+    std::vector<rasterTriangle> rasterTris;
+    std::vector<std::vector<int>> bins;
+    taskArena arena; // 本帧提交的任务都从这里分配，帧完成后整体回收
+    taskGraph graph;      // 本帧的阶段依赖图，模型个数变化时才重建
+    int graphModels = -1; // graph 按多少个模型建成，-1 表示尚未建图
+    bool clear = false;   // 本帧先按新尺寸重建缓冲
+    completionLatch done;
+    bool inFlight = false;
+    explicit frameContext(ThreadPool &pool) : graph(pool) {}
+};
+
+// 屏幕分块，每块只由一个线程光栅化，块内深度 / 颜色无需原子操作
+struct tileBuffer
+{
+    static constexpr int size = 64;
+    static constexpr uint32_t noTriangle = UINT32_MAX;
+    int x0, y0, x1, y1;
+    fragmentPass pass;
+    const frameContext *frame;
+    renderStats stats;
+    // 末尾留出一个 SIMD 宽度，向量读写越过最后一行时不会越界
+    float depth[size * size + 8];
+    uint32_t color[size * size + 8];
+    uint32_t id[size * size + 8]; // visibility 模式下每个像素可见三角形在 rasterTris 中的下标
+
+    // 分层 Z: 每个 8x8 小块记录已写入深度的最大值，写入后只标脏，查询时再重算
+    static constexpr int blockSize = 8, blocks = size / blockSize;
+    float blockMaxZ[blocks * blocks];
+    bool blockDirty[blocks * blocks];
+    float maxDepth(int bx, int by);
+};
+
+// 边函数用定点数：顶点坐标吸附到 1/subPixel 像素，边函数值是精确整数，
+// 覆盖判定与 top-left 规则不受浮点舍入影响，共享边上的像素不会重复或遗漏
+struct edgeSetup
+{
+    static constexpr int subPixelBits = 8, subPixel = 1 << subPixelBits;
+    int64_t stepX[3], stepY[3]; // 沿 x / y 方向移动一个像素时边函数的增量
+    int64_t rowW[3];            // 当前行起点处的边函数值
+    bool topLeft[3];
+    real invArea;               // 1 / 两倍面积，单位与边函数一致，w * invArea 即重心坐标
+};
 
 class rasterizer
 {
 private:
+    // 保护带：屏幕外 guardBand 像素以内的三角形不做 x / y 裁剪，只靠包围盒截断；超出才裁剪，保证坐标有界
+    static constexpr double guardBand = 1 << 14;
+    static constexpr int clipPlaneCount = 6, maxClipVerts = 3 + clipPlaneCount;
     int width, height;
     bool resize;
     uint32_t bkColor;
     camera *pCam = nullptr;
-    std::deque<std::atomic<float>> zBuffer;
-    std::vector<uint32_t> frameBuffer;
+    rasterizeMode mode = rasterizeMode::edgeFunction;
+    bool hiZ = true;
+    renderPipeline pipeline = renderPipeline::forward;
+    renderStats stats; // 最近一次 draw 返回的那一帧的统计
+    Matrix viewportMatrix;
+    int tilesX = 0, tilesY = 0;
     lightShader lig;
     ThreadPool &poolIns;
-    std::vector<std::reference_wrapper<model>> models;
-    std::vector<std::future<void>> threads;
+    // 流水线：draw 提交新的一帧后返回上一帧，新帧的几何阶段与上一帧的显示、以及尚未完成的光栅化重叠
+    static constexpr int maxFramesInFlight = 2;
+    std::unique_ptr<frameContext> frames[maxFramesInFlight];
+    int framesInFlight = 1, nextFrame = 0;
+    frameContext *shown = nullptr; // 最近一次 draw 返回的帧，调用方可能仍在显示它
+    // 场景中的模型：直接给出的 model，或异步载入的资源
+    struct sceneModel
+    {
+        model *mod = nullptr;
+        modelHandle asset;
+    };
+    std::vector<sceneModel> models;
+    const model *placeholder = nullptr;
 
-    void clearBuffer();
-    void drawTriangle(Triangle tri, Triangle ctri, const model &mod, int startX, int endX, bool mutiThread = false);
-    void rasterizeLine(Triangle tri, Triangle ctri, const model &mod, int x, int startY, int endY);
-    void setPixel(int x, int y, int r, int g, int b);
+    void clearBuffer(frameContext &f);
+    modelTransform getModelMatrix(frameContext &f, const Matrix &modelMatrix, cullMode cull);
+    void addToFrame(frameContext &f, const model &m, const Matrix &modelMatrix, cullMode cull);
+    float screenRadius(const Matrix &modelMatrix, const meshBounds &bounds) const;
+    void submitFrame(frameContext &f, bool resized);
+    void waitFrame(frameContext &f);
+    void transformModel(frameContext &f, int i);
+    static void transformVertices(const model &m, const modelTransform &mt, vertexStream &out, size_t base, size_t begin, size_t end);
+    static Triangle assembleTriangle(const model &m, const vertexStream &vs, size_t base, const uint32_t *idx, bool clipSpace);
+    static Triangle assembleView(const vertexStream &vs, size_t base, const uint32_t *idx);
+    void setupTriangles(frameContext &f, int i);
+    void emitTriangle(frameContext &f, const model &m, cullMode cull, Triangle tri, const Triangle &ctri);
+    void binTriangles(frameContext &f);
+    void rasterizeTiles(frameContext &f);
+    void present(frameContext &f);
+    void rasterizeTile(frameContext &f, int idx);
+    void rasterizeBin(tileBuffer &tile, int idx, simdLevel level);
+    void resolveTile(tileBuffer &tile, simdLevel level);
+    void rasterizeRect(tileBuffer &tile, const rasterTriangle &rt, simdLevel level, int startX, int endX, int startY, int endY);
+    void drawTriangle(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY);
+    void rasterizeLine(tileBuffer &tile, const rasterTriangle &rt, int x, int startY, int endY);
+    static bool setupEdges(const Triangle &tri, int startX, int startY, edgeSetup &e);
+    void drawTriangleEdge(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY);
+    static void triangleAttributes(const rasterTriangle &rt, real invArea, float (*attr)[3]);
+    void drawTriangleSse4(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY);
+    void drawTriangleAvx2(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY);
+    void drawTriangleAvx512(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY);
+    void shadeFragment(tileBuffer &tile, const rasterTriangle &rt, int x, int y, const real *param);
+    uint32_t shadePixel(const tileBuffer &tile, const rasterTriangle &rt, vec3 pos, vec3 nor, real u, real v, vec3 vertexColor);
+    void shadeBatch(const tileBuffer &tile, const rasterTriangle &rt, fragmentBatch &batch, uint32_t *color);
+    static void fillBatch(const rasterTriangle &rt, const real *param, fragmentBatch &batch, int lane);
+    void setPixel(frameContext &f, int x, int y, int r, int g, int b);
+    void drawLine(frameContext &f, Point begin, Point end, vec3 lineColor);
 
 public:
-    rasterizer(int width, int height);
+    rasterizer(int width, int height, ThreadPool &pool = ThreadPool::getInstance());
+    ~rasterizer() { finish(); }
     void setRasterizeSize(int width, int height);
     std::span<uint32_t> draw();
-    void setCamera(camera &cam) { pCam = &cam; }
+    void setCamera(camera &cam)
+    {
+        finish();
+        pCam = &cam;
+    }
     void addLight(vec3 pos);
+    // 画在最近一次 draw 返回的帧上
     void drawLine(Point begin, Point end, vec3 lineColor = {255, 255, 255});
-    void pushModel(model &m) { models.push_back(m); }
+    void pushModel(model &m)
+    {
+        finish();
+        models.push_back({&m, nullptr});
+    }
+    // 资源可以尚未载入：就绪前每帧按估计的屏幕大小更新它的载入优先级，并画占位模型（没有则跳过）
+    void pushModel(modelHandle asset)
+    {
+        finish();
+        asset->priority.store(screenRadius(asset->modelMatrix, asset->estimate), std::memory_order_relaxed);
+        models.push_back({nullptr, std::move(asset)});
+    }
+    // 占位模型应位于以原点为中心的单位球内，绘制时缩放平移到资源估计的包围球；传 nullptr 表示跳过
+    void setPlaceholder(const model *m)
+    {
+        finish();
+        placeholder = m;
+    }
     void setBkColor(int r, int g, int b);
+    void setRasterizeMode(rasterizeMode m)
+    {
+        finish();
+        mode = m;
+    }
+    rasterizeMode getRasterizeMode() const { return mode; }
+    void setHiZ(bool enable)
+    {
+        finish();
+        hiZ = enable;
+    }
+    void setPipeline(renderPipeline p)
+    {
+        finish();
+        pipeline = p;
+    }
+    renderPipeline getPipeline() const { return pipeline; }
+    const renderStats &getStats() const { return stats; }
+    // 同时在飞行的帧数，默认 1 为同步绘制；2 时 draw 返回上一帧，延迟多一帧换取几何与光栅化重叠，
+    // 切换后头两次 draw 返回同一帧。只有调用方显示一帧的耗时足以让工作线程做完下一帧的几何时才有收益，
+    // 可用 bench --suite inflight 测量
+    void setFramesInFlight(int n);
+    int getFramesInFlight() const { return framesInFlight; }
+    // 等待所有在飞行的帧完成；修改已提交的模型之前必须调用
+    void finish();
 };
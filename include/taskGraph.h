@@ -0,0 +1,96 @@
+#pragma once
+#include "ThreadPool.h"
+#include <functional>
+#include <vector>
+#include <atomic>
+#include <memory>
+
+// 任务图：节点是一段工作，边表示先后依赖。run 时没有前驱的节点先提交，
+// 每个节点完成后给后继的计数减一，减到零的后继立即提交，互不依赖的节点自然并行
+class taskGraph
+{
+public:
+    using nodeId = int;
+
+private:
+    struct node
+    {
+        std::function<void()> fn;
+        std::vector<nodeId> succ;
+        int preds = 0;
+    };
+
+    ThreadPool &pool;
+    std::vector<node> nodes;
+    std::unique_ptr<std::atomic<int>[]> pending; // 每个节点还未完成的前驱数
+    size_t pendingSize = 0;
+    taskArena *arena = nullptr;
+    completionLatch *latch = nullptr;
+
+    void submit(nodeId id)
+    {
+        pool.submit(*arena, *latch, [this, id]
+                    { execute(id); });
+    }
+
+    void execute(nodeId id)
+    {
+        nodes[id].fn();
+        for (nodeId s : nodes[id].succ)
+            if (pending[s].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                submit(s);
+    }
+
+public:
+    explicit taskGraph(ThreadPool &pool) : pool(pool) {}
+
+    template <typename F>
+    nodeId add(F &&f)
+    {
+        nodes.push_back({std::forward<F>(f), {}, 0});
+        return nodeId(nodes.size() - 1);
+    }
+
+    // before 完成之后 after 才能开始
+    void precede(nodeId before, nodeId after)
+    {
+        nodes[before].succ.push_back(after);
+        nodes[after].preds++;
+    }
+
+    // 开始执行整张图后立即返回，所有节点完成时 latch 归零；图可以重复执行，但同一时刻只能有一次在执行
+    void start(taskArena &taskMem, completionLatch &done)
+    {
+        if (nodes.empty())
+            return;
+        if (pendingSize < nodes.size())
+        {
+            pending.reset(new std::atomic<int>[nodes.size()]);
+            pendingSize = nodes.size();
+        }
+        for (size_t i = 0; i < nodes.size(); i++)
+            pending[i].store(nodes[i].preds, std::memory_order_relaxed);
+        arena = &taskMem;
+        latch = &done;
+        // 提交期间多占一个计数，先提交的分支全部跑完也不会让 latch 提前归零
+        done.add(1);
+        for (size_t i = 0; i < nodes.size(); i++)
+            if (!nodes[i].preds)
+                submit(nodeId(i));
+        done.countDown();
+    }
+
+    // 执行整张图，返回时所有节点都已完成。done 在栈上，最后一个节点的 countDown 离开之前 wait 不会返回；
+    // 返回后清掉指向它的指针，图里不留悬空的 latch
+    void run(taskArena &taskMem)
+    {
+        completionLatch done;
+        start(taskMem, done);
+        pool.wait(done);
+        latch = nullptr;
+        arena = nullptr;
+    }
+
+    // 清空节点与依赖，之后可以重新建图
+    void clear() { nodes.clear(); }
+};
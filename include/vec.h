@@ -1,24 +1,34 @@
 #pragma once
-class vec3
+// 数学类型的默认标量：默认单精度，定义 RASTERIZER_DOUBLE 时整条管线回到双精度
+#ifdef RASTERIZER_DOUBLE
+using real = double;
+#else
+using real = float;
+#endif
+
+template <typename T>
+class vec3T
 {
 private:
-    double data[3];
-    void setValue(double a, double b, double c);
+    T data[3];
+    void setValue(T a, T b, T c);
 
 public:
-    vec3(double a, double b, double c) { setValue(a, b, c); }
-    vec3() { setValue(0, 0, 0); }
-    double &operator[](int i) { return data[i]; }
-    vec3 operator+(vec3 v);
-    void operator+=(vec3 v);
-    vec3 operator/(double f);
-    void operator/=(double f);
-    vec3 operator-(vec3 v);
-    vec3 operator*(double f);
-    double operator*(vec3 v);
-    double len();
-    vec3 normalize();
-    vec3 cross(vec3 v);
+    vec3T(T a, T b, T c) { setValue(a, b, c); }
+    vec3T() { setValue(0, 0, 0); }
+    T &operator[](int i) { return data[i]; }
+    vec3T operator+(vec3T v);
+    void operator+=(vec3T v);
+    vec3T operator/(T f);
+    void operator/=(T f);
+    vec3T operator-(vec3T v);
+    vec3T operator*(T f);
+    T operator*(vec3T v);
+    T len();
+    vec3T normalize();
+    vec3T cross(vec3T v);
     void abs();
     void printData();
 };
+
+using vec3 = vec3T<real>;
@@ -1,11 +1,208 @@
 #include "Matrix.h"
 #include "Triangle.h"
+#include "cpuFeature.h"
 #include <iostream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MATRIX_X86_SIMD
+#endif
 using namespace std;
 
-void Matrix::init(initializer_list<initializer_list<double>> list)
+// 4x4 行主序矩阵乘法 / 矩阵乘点的多版本内核，按 cpuFeature::level() 选择
+template <typename T>
+static void mulScalar(const T *a, const T *b, T *res)
 {
-    for (double &i : data)
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            for (int k = 0; k < 4; k++)
+                res[i * 4 + j] += a[i * 4 + k] * b[k * 4 + j];
+}
+
+template <typename T>
+static void mulPointScalar(const T *a, const T *p, T *res)
+{
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            res[i] += a[i * 4 + j] * p[j];
+}
+
+#ifdef MATRIX_X86_SIMD
+__attribute__((target("sse4.2"))) static void mulSse4(const double *a, const double *b, double *res)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        __m128d lo = _mm_setzero_pd(), hi = _mm_setzero_pd();
+        for (int k = 0; k < 4; k++)
+        {
+            __m128d s = _mm_set1_pd(a[i * 4 + k]);
+            lo = _mm_add_pd(lo, _mm_mul_pd(s, _mm_loadu_pd(b + k * 4)));
+            hi = _mm_add_pd(hi, _mm_mul_pd(s, _mm_loadu_pd(b + k * 4 + 2)));
+        }
+        _mm_storeu_pd(res + i * 4, lo);
+        _mm_storeu_pd(res + i * 4 + 2, hi);
+    }
+}
+
+__attribute__((target("sse4.2"))) static void mulPointSse4(const double *a, const double *p, double *res)
+{
+    __m128d p0 = _mm_loadu_pd(p), p1 = _mm_loadu_pd(p + 2);
+    for (int i = 0; i < 4; i++)
+    {
+        __m128d r = _mm_add_pd(_mm_dp_pd(_mm_loadu_pd(a + i * 4), p0, 0x31), _mm_dp_pd(_mm_loadu_pd(a + i * 4 + 2), p1, 0x31));
+        _mm_store_sd(res + i, r);
+    }
+}
+
+__attribute__((target("avx2,fma"))) static void mulAvx2(const double *a, const double *b, double *res)
+{
+    __m256d row[4];
+    for (int k = 0; k < 4; k++)
+        row[k] = _mm256_loadu_pd(b + k * 4);
+    for (int i = 0; i < 4; i++)
+    {
+        __m256d r = _mm256_mul_pd(_mm256_broadcast_sd(a + i * 4), row[0]);
+        for (int k = 1; k < 4; k++)
+            r = _mm256_fmadd_pd(_mm256_broadcast_sd(a + i * 4 + k), row[k], r);
+        _mm256_storeu_pd(res + i * 4, r);
+    }
+}
+
+__attribute__((target("avx2,fma"))) static void mulPointAvx2(const double *a, const double *p, double *res)
+{
+    __m256d v = _mm256_loadu_pd(p);
+    __m256d r0 = _mm256_mul_pd(_mm256_loadu_pd(a), v);
+    __m256d r1 = _mm256_mul_pd(_mm256_loadu_pd(a + 4), v);
+    __m256d r2 = _mm256_mul_pd(_mm256_loadu_pd(a + 8), v);
+    __m256d r3 = _mm256_mul_pd(_mm256_loadu_pd(a + 12), v);
+    // {r0.01, r1.01, r0.23, r1.23} 与 {r2.01, r3.01, r2.23, r3.23} 再跨 128 位相加
+    __m256d s01 = _mm256_hadd_pd(r0, r1);
+    __m256d s23 = _mm256_hadd_pd(r2, r3);
+    __m256d lo = _mm256_permute2f128_pd(s01, s23, 0x20);
+    __m256d hi = _mm256_permute2f128_pd(s01, s23, 0x31);
+    _mm256_storeu_pd(res, _mm256_add_pd(lo, hi));
+}
+
+// 两行一组: 低 256 位算第 i 行，高 256 位算第 i + 1 行
+__attribute__((target("avx512f,avx512dq,fma"))) static void mulAvx512(const double *a, const double *b, double *res)
+{
+    __m512d row[4];
+    for (int k = 0; k < 4; k++)
+        row[k] = _mm512_broadcast_f64x4(_mm256_loadu_pd(b + k * 4));
+    for (int i = 0; i < 4; i += 2)
+    {
+        __m512d r = _mm512_setzero_pd();
+        for (int k = 0; k < 4; k++)
+        {
+            __m512d s = _mm512_insertf64x4(_mm512_set1_pd(a[i * 4 + k]), _mm256_set1_pd(a[(i + 1) * 4 + k]), 1);
+            r = _mm512_fmadd_pd(s, row[k], r);
+        }
+        _mm512_storeu_pd(res + i * 4, r);
+    }
+}
+
+// 单精度：一行 4 个 float 正好一个 128 位寄存器
+__attribute__((target("sse4.2"))) static void mulSse4(const float *a, const float *b, float *res)
+{
+    __m128 row[4];
+    for (int k = 0; k < 4; k++)
+        row[k] = _mm_loadu_ps(b + k * 4);
+    for (int i = 0; i < 4; i++)
+    {
+        __m128 r = _mm_mul_ps(_mm_set1_ps(a[i * 4]), row[0]);
+        for (int k = 1; k < 4; k++)
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[i * 4 + k]), row[k]));
+        _mm_storeu_ps(res + i * 4, r);
+    }
+}
+
+__attribute__((target("sse4.2"))) static void mulPointSse4(const float *a, const float *p, float *res)
+{
+    __m128 v = _mm_loadu_ps(p);
+    for (int i = 0; i < 4; i++)
+        _mm_store_ss(res + i, _mm_dp_ps(_mm_loadu_ps(a + i * 4), v, 0xF1));
+}
+
+// 两行一组: 低 128 位算第 i 行，高 128 位算第 i + 1 行
+__attribute__((target("avx2,fma"))) static void mulAvx2(const float *a, const float *b, float *res)
+{
+    __m256 row[4];
+    for (int k = 0; k < 4; k++)
+        row[k] = _mm256_broadcast_ps((const __m128 *)(b + k * 4));
+    for (int i = 0; i < 4; i += 2)
+    {
+        __m256 r = _mm256_setzero_ps();
+        for (int k = 0; k < 4; k++)
+            r = _mm256_fmadd_ps(_mm256_setr_m128(_mm_set1_ps(a[i * 4 + k]), _mm_set1_ps(a[(i + 1) * 4 + k])), row[k], r);
+        _mm256_storeu_ps(res + i * 4, r);
+    }
+}
+#endif
+
+static void mul(const float *a, const float *b, float *res)
+{
+#ifdef MATRIX_X86_SIMD
+    switch (cpuFeature::level())
+    {
+    case simdLevel::avx512: // 16 个 float 的乘积用两个 256 位寄存器已足够
+    case simdLevel::avx2:
+        return mulAvx2(a, b, res);
+    case simdLevel::sse4:
+        return mulSse4(a, b, res);
+    default:
+        break;
+    }
+#endif
+    mulScalar(a, b, res);
+}
+
+static void mulPoint(const float *a, const float *p, float *res)
+{
+#ifdef MATRIX_X86_SIMD
+    if (cpuFeature::level() != simdLevel::scalar)
+        return mulPointSse4(a, p, res);
+#endif
+    mulPointScalar(a, p, res);
+}
+
+static void mul(const double *a, const double *b, double *res)
+{
+#ifdef MATRIX_X86_SIMD
+    switch (cpuFeature::level())
+    {
+    case simdLevel::avx512:
+        return mulAvx512(a, b, res);
+    case simdLevel::avx2:
+        return mulAvx2(a, b, res);
+    case simdLevel::sse4:
+        return mulSse4(a, b, res);
+    default:
+        break;
+    }
+#endif
+    mulScalar(a, b, res);
+}
+
+static void mulPoint(const double *a, const double *p, double *res)
+{
+#ifdef MATRIX_X86_SIMD
+    switch (cpuFeature::level())
+    {
+    case simdLevel::avx512: // 只有 4 个 double，AVX2 版本已占满
+    case simdLevel::avx2:
+        return mulPointAvx2(a, p, res);
+    case simdLevel::sse4:
+        return mulPointSse4(a, p, res);
+    default:
+        break;
+    }
+#endif
+    mulPointScalar(a, p, res);
+}
+
+template <typename T>
+void MatrixT<T>::init(initializer_list<initializer_list<double>> list)
+{
+    for (T &i : data)
         i = 0;
     auto l = list.begin();
     for (int i = 0; i < 4 && l != list.end(); i++)
@@ -13,116 +210,113 @@ void Matrix::init(initializer_list<initializer_list<double>> list)
         auto ll = l->begin();
         for (int j = 0; j < 4 && ll != l->end(); j++)
         {
-            data[i * 4 + j] = *ll;
+            data[i * 4 + j] = T(*ll);
             ll++;
         }
         l++;
     }
 }
 
-void Matrix::printData()
+template <typename T>
+void MatrixT<T>::printData()
 {
     for (int i = 0; i < 4; i++)
     {
         for (int j = 0; j < 4; j++)
         {
-            printf("%-8.3f", data[i * 4 + j]);
+            printf("%-8.3f", double(data[i * 4 + j]));
         }
         putchar('\n');
     }
 }
 
-Matrix::Matrix(std::initializer_list<std::initializer_list<double>> list)
+template <typename T>
+MatrixT<T>::MatrixT(std::initializer_list<std::initializer_list<double>> list)
 {
     init(list);
 }
 
-Matrix::Matrix()
+template <typename T>
+MatrixT<T>::MatrixT()
 {
-    for (double &i : data)
+    for (T &i : data)
         i = 0;
 }
 
-Matrix &Matrix::operator=(std::initializer_list<std::initializer_list<double>> list)
+template <typename T>
+MatrixT<T> &MatrixT<T>::operator=(std::initializer_list<std::initializer_list<double>> list)
 {
     init(list);
     return *this;
 }
 
-Matrix Matrix::operator*(Matrix m)
+template <typename T>
+MatrixT<T> MatrixT<T>::operator*(MatrixT m)
 {
-    Matrix res;
-    for (int i = 0; i < 4; i++)
-        for (int j = 0; j < 4; j++)
-            for (int k = 0; k < 4; k++)
-                res.data[i * 4 + j] += data[i * 4 + k] * m.data[k * 4 + j];
-
+    MatrixT res;
+    mul(data, m.data, res.data);
     return res;
 }
 
-void Matrix::operator*=(Matrix m)
+template <typename T>
+void MatrixT<T>::operator*=(MatrixT m)
 {
     *this = *this * m;
 }
 
-Triangle Matrix::operator*(Triangle tri)
+template <typename T>
+TriangleT<T> MatrixT<T>::operator*(TriangleT<T> tri)
 {
-    Triangle res = tri;
-    Matrix tmp;
-
-    for (int i = 0; i < 4; i++)
-        for (int j = 0; j < 3; j++)
-            tmp.setData(i, j, tri.getVertex(j)[i]);
-
-    tmp = *this * tmp;
+    TriangleT<T> res = tri;
     for (int i = 0; i < 3; i++)
-        for (int j = 0; j < 4; j++)
-            res.getVertex(i)[j] = tmp.getData(j, i);
-
+        res.getVertex(i) = *this * tri.getVertex(i);
     return res;
 }
 
-Matrix Matrix::operator*(double f)
+template <typename T>
+MatrixT<T> MatrixT<T>::operator*(T f)
 {
-    Matrix res = *this;
-    for (double &i : res.data)
+    MatrixT res = *this;
+    for (T &i : res.data)
         i *= f;
     return res;
 }
 
-void Matrix::operator*=(double f)
+template <typename T>
+void MatrixT<T>::operator*=(T f)
 {
-    for (double &i : data)
+    for (T &i : data)
         i *= f;
 }
 
-Matrix Matrix::operator+(Matrix m)
+template <typename T>
+MatrixT<T> MatrixT<T>::operator+(MatrixT m)
 {
-    Matrix res = *this;
+    MatrixT res = *this;
     for (int i = 0; i < 4 * 4; i++)
         res.data[i] += m.data[i];
     return res;
 }
 
-void Matrix::operator+=(Matrix m)
+template <typename T>
+void MatrixT<T>::operator+=(MatrixT m)
 {
     for (int i = 0; i < 4 * 4; i++)
         data[i] += m.data[i];
 }
 
-Point Matrix::operator*(Point m)
+template <typename T>
+PointT<T> MatrixT<T>::operator*(PointT<T> m)
 {
-    Point res;
-
-    for (int i = 0; i < 4; i++)
-        for (int j = 0; j < 4; j++)
-            res.data[i] += data[i * 4 + j] * m.data[j];
+    PointT<T> res;
+    mulPoint(data, m.data, res.data);
     return res;
 }
 
-vec3 Matrix::operator*(vec3 v)
+template <typename T>
+vec3T<T> MatrixT<T>::operator*(vec3T<T> v)
 {
-    vec3 res;
+    vec3T<T> res;
 
     for (int i = 0; i < 3; i++)
         for (int j = 0; j < 3; j++)
@@ -130,18 +324,20 @@ vec3 Matrix::operator*(vec3 v)
     return res;
 }
 
-Matrix Matrix::trans()
+template <typename T>
+MatrixT<T> MatrixT<T>::trans()
 {
-    Matrix res;
+    MatrixT res;
     for (int i = 0; i < 4; i++)
         for (int j = 0; j < 4; j++)
             res.setData(i, j, getData(j, i));
     return res;
 }
 
-Matrix Matrix::inverse()
+template <typename T>
+MatrixT<T> MatrixT<T>::inverse()
 {
-    Matrix res;
+    MatrixT res;
     int i, j, k;
     double W[4][8];
     double tem_1, tem_2, tem_3;
@@ -208,16 +404,17 @@ Matrix Matrix::inverse()
     {
         for (j = 4; j < 2 * 4; j++)
         {
-            res.setData(i, j - 4, W[i][j]);
+            res.setData(i, j - 4, T(W[i][j]));
         }
     }
 
     return res;
 }
 
-Matrix Matrix::identity()
+template <typename T>
+MatrixT<T> MatrixT<T>::identity()
 {
-    static Matrix res;
+    static MatrixT res;
     static bool bInit = false;
     if (bInit)
         return res;
@@ -226,3 +423,7 @@ Matrix Matrix::identity()
             res.setData(i, j, i == j);
     return res;
 }
+
+
+template class MatrixT<float>;
+template class MatrixT<double>;
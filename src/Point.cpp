@@ -4,57 +4,67 @@
 using namespace std;
 
 
-Point Point::normalize()
+template <typename T>
+PointT<T> PointT<T>::normalize()
 {
-    Point res = *this;
+    PointT res = *this;
     for (int i = 0; i < 4; i++)
         res[i] /= res[3];
     return res;
 }
 
 
-Point::Point()
+template <typename T>
+PointT<T>::PointT()
 {
-    for (double &i : data)
+    for (T &i : data)
         i = 0;
 }
 
 
-Point::Point(std::initializer_list<double> list)
+template <typename T>
+PointT<T>::PointT(std::initializer_list<double> list)
 {
     *this = list;
 }
 
 
-void Point::printData()
+template <typename T>
+void PointT<T>::printData()
 {
-    for (double v : data)
-        printf("%-8.3f", v);
+    for (T v : data)
+        printf("%-8.3f", double(v));
     putchar('\n');
 }
 
 
-Point &Point::operator=(initializer_list<double> list)
+template <typename T>
+PointT<T> &PointT<T>::operator=(initializer_list<double> list)
 {
     auto it = list.begin();
-    for (int i = 0; i < list.size(); i++)
+    for (size_t i = 0; i < list.size(); i++)
     {
-        data[i] = it[i];
+        data[i] = T(it[i]);
     }
     return *this;
 }
 
 
-double &Point::operator[](int idx)
+template <typename T>
+T &PointT<T>::operator[](int idx)
 {
     return data[idx];
 }
 
 
-Point Point::operator-(Point &p)
+template <typename T>
+PointT<T> PointT<T>::operator-(PointT &p)
 {
-    Point res;
+    PointT res;
     for (int i = 0; i < 4; i++)
         res[i] = data[i] - p[i];
     return res;
-}
\ No newline at end of file
+}
+
+template class PointT<float>;
+template class PointT<double>;
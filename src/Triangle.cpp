@@ -1,19 +1,23 @@
 #include "Triangle.h"
 #include <stdio.h>
 #include <memory>
+#include <cmath>
 
-void Triangle::initColor()
+template <typename T>
+void TriangleT<T>::initColor()
 {
     setColor(255, 255, 255);
 }
 
-Triangle::Triangle(std::initializer_list<Point> list)
+template <typename T>
+TriangleT<T>::TriangleT(std::initializer_list<PointT<T>> list)
 {
     *this = list;
     initColor();
 }
 
-Triangle &Triangle::operator=(std::initializer_list<Point> list)
+template <typename T>
+TriangleT<T> &TriangleT<T>::operator=(std::initializer_list<PointT<T>> list)
 {
     auto it = list.begin();
     for (int i = 0; i < 3; i++)
@@ -25,17 +29,19 @@ Triangle &Triangle::operator=(std::initializer_list<Point> list)
     return *this;
 }
 
-void Triangle::printData()
+template <typename T>
+void TriangleT<T>::printData()
 {
     for (int i = 0; i < 3; i++)
     {
         for (int j = 0; j < 4; j++)
-            printf("%-6.3g", ver[i][j]);
+            printf("%-6.3g", double(ver[i][j]));
         putchar('\n');
     }
 }
 
-bool Triangle::inside(double x, double y)
+template <typename T>
+bool TriangleT<T>::inside(double x, double y)
 {
     double ax = ver[0][0], ay = ver[0][1];
     double bx = ver[1][0], by = ver[1][1];
@@ -48,20 +54,47 @@ bool Triangle::inside(double x, double y)
     return fg1 == fg2 && fg2 == fg3;
 }
 
-Triangle Triangle::normalize()
+template <typename T>
+TriangleT<T> TriangleT<T>::normalize()
 {
-    Triangle res = *this;
+    TriangleT res = *this;
     for (int i = 0; i < 3; i++)
         res.ver[i] = ver[i].normalize();
     return res;
 }
 
-void Triangle::setVertex(vec3 p, int idx)
+template <typename T>
+TriangleT<T> TriangleT<T>::subTriangle(const double (*weight)[3]) const
+{
+    TriangleT res = *this;
+    bool hasNormal = normal[0] && normal[1] && normal[2];
+    for (int i = 0; i < 3; i++)
+    {
+        const double *w = weight[i];
+        for (int k = 0; k < 4; k++)
+            res.ver[i].data[k] = T(w[0] * ver[0].data[k] + w[1] * ver[1].data[k] + w[2] * ver[2].data[k]);
+        res.uTex[i] = T(w[0] * uTex[0] + w[1] * uTex[1] + w[2] * uTex[2]);
+        res.vTex[i] = T(w[0] * vTex[0] + w[1] * vTex[1] + w[2] * vTex[2]);
+        res.colorR[i] = int(lround(w[0] * colorR[0] + w[1] * colorR[1] + w[2] * colorR[2]));
+        res.colorG[i] = int(lround(w[0] * colorG[0] + w[1] * colorG[1] + w[2] * colorG[2]));
+        res.colorB[i] = int(lround(w[0] * colorB[0] + w[1] * colorB[1] + w[2] * colorB[2]));
+        if (hasNormal)
+        {
+            vec3T<T> n0 = *normal[0], n1 = *normal[1], n2 = *normal[2];
+            res.normal[i] = n0 * T(w[0]) + n1 * T(w[1]) + n2 * T(w[2]);
+        }
+    }
+    return res;
+}
+
+template <typename T>
+void TriangleT<T>::setVertex(vec3T<T> p, int idx)
 {
     ver[idx] = {p[0], p[1], p[2], 1};
 }
 
-void Triangle::setColor(int r, int g, int b, int idx)
+template <typename T>
+void TriangleT<T>::setColor(int r, int g, int b, int idx)
 {
     for (int i = 0; i < 3; i++)
         if (idx == -1 || idx == i)
@@ -72,13 +105,18 @@ void Triangle::setColor(int r, int g, int b, int idx)
         }
 }
 
-void Triangle::setNormal(vec3 n, int idx)
+template <typename T>
+void TriangleT<T>::setNormal(vec3T<T> n, int idx)
 {
     normal[idx] = n;
 }
 
-void Triangle::setTexCoord(double u, double v, int idx)
+template <typename T>
+void TriangleT<T>::setTexCoord(double u, double v, int idx)
 {
-    uTex[idx] = u;
-    vTex[idx] = v;
-}
\ No newline at end of file
+    uTex[idx] = T(u);
+    vTex[idx] = T(v);
+}
+
+template class TriangleT<float>;
+template class TriangleT<double>;
@@ -0,0 +1,90 @@
+#include "assetManager.h"
+#include "meshCache.h"
+#include <algorithm>
+using namespace std;
+
+static poolConfig loaderConfig(int threads)
+{
+    poolConfig cfg;
+    cfg.threads = max(1, threads);
+    return cfg;
+}
+
+assetManager::assetManager(int threads) : pool(loaderConfig(threads))
+{
+}
+
+assetManager::~assetManager()
+{
+    {
+        lock_guard l(mtx);
+        queue.clear();
+    }
+    pool.wait(running);
+}
+
+modelHandle assetManager::loadModel(const string &objPath, const string &texturePath, float radiusHint, bool analyze)
+{
+    auto a = make_shared<modelAsset>();
+    a->objPath = objPath;
+    a->texturePath = texturePath;
+    a->analyze = analyze;
+    // 缓存头只有几百字节，读它比等网格载入完再估计大小划算
+    if (!meshCache::peekBounds(objPath.c_str(), a->estimate))
+        a->estimate.radius = radiusHint;
+    int jobs = texturePath.empty() ? 1 : 2;
+    a->remaining.store(jobs, memory_order_relaxed);
+    lock_guard l(mtx);
+    for (int i = 0; i < jobs; i++)
+        queue.push_back({a, i == 1, nextSeq++});
+    // 没有作业在飞行时任务内存都已归还，可以整体回收；在锁内判断，其他线程不会同时提交
+    if (running.done())
+        tasks.reset();
+    // 每个作业对应一个任务，但任务执行时取的是当时优先级最高的作业，不一定是自己提交的那个。
+    // 任务完成时 submit 对 running 计数减一，不必为每个作业分配 future
+    for (int i = 0; i < jobs; i++)
+        pool.submit(tasks, running, [this]
+                    { runNext(); });
+    return a;
+}
+
+void assetManager::runNext()
+{
+    job j;
+    {
+        lock_guard l(mtx);
+        if (queue.empty())
+            return;
+        auto best = max_element(queue.begin(), queue.end(), [](const job &a, const job &b)
+                                {
+            float pa = a.asset->priority.load(memory_order_relaxed), pb = b.asset->priority.load(memory_order_relaxed);
+            return pa < pb || (pa == pb && a.seq > b.seq); });
+        j = move(*best);
+        *best = move(queue.back());
+        queue.pop_back();
+    }
+    modelAsset &a = *j.asset;
+    assetState expected = assetState::pending;
+    a.state.compare_exchange_strong(expected, assetState::loading, memory_order_relaxed);
+    // 网格与纹理作业写 geometry 中互不相交的成员，可以同时进行。
+    // 异常（内存不足、映射失败等）在这里吞下并记为失败，否则资源会一直停在 loading、占位模型永远不撤
+    try
+    {
+        if (j.texture)
+            a.geometry.loadTexture(a.texturePath.c_str());
+        else if (!a.geometry.loadObj(a.objPath.c_str(), true, pool, a.analyze ? &a.analysis : nullptr))
+            a.loadFailed.store(true, memory_order_relaxed);
+    }
+    catch (...)
+    {
+        a.loadFailed.store(true, memory_order_relaxed);
+    }
+    // 最后完成的作业发布结果：acq_rel 保证另一个作业的写入也对读到 ready 的线程可见
+    if (a.remaining.fetch_sub(1, memory_order_acq_rel) == 1)
+        a.state.store(a.loadFailed.load(memory_order_relaxed) ? assetState::failed : assetState::ready, memory_order_release);
+}
+
+void assetManager::waitAll()
+{
+    pool.wait(running);
+}
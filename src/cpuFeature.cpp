@@ -0,0 +1,73 @@
+#include "cpuFeature.h"
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+using namespace std;
+
+static simdLevel detectLevel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSE4_2))
+        return simdLevel::scalar;
+    simdLevel res = simdLevel::sse4;
+
+    // 还需确认操作系统会保存 YMM / ZMM 寄存器
+    if (!(c & bit_OSXSAVE) || !(c & bit_AVX) || !(c & bit_FMA))
+        return res;
+    unsigned xcr0, xcr0Hi;
+    __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0Hi) : "c"(0));
+    if ((xcr0 & 0x6) != 0x6 || !__get_cpuid_count(7, 0, &a, &b, &c, &d))
+        return res;
+    if (b & bit_AVX2)
+        res = simdLevel::avx2;
+    if (res == simdLevel::avx2 && (xcr0 & 0xe0) == 0xe0 && (b & bit_AVX512F) && (b & bit_AVX512DQ))
+        res = simdLevel::avx512;
+    return res;
+#else
+    return simdLevel::scalar;
+#endif
+}
+
+simdLevel cpuFeature::detected()
+{
+    static const simdLevel res = detectLevel();
+    return res;
+}
+
+simdLevel &cpuFeature::current()
+{
+    static simdLevel res = []
+    {
+        simdLevel l = detected();
+        if (const char *env = getenv("RASTERIZER_SIMD"))
+            for (simdLevel s : {simdLevel::scalar, simdLevel::sse4, simdLevel::avx2, simdLevel::avx512})
+                if (strcmp(env, name(s)) == 0)
+                    l = min(s, l);
+        return l;
+    }();
+    return res;
+}
+
+void cpuFeature::setLevel(simdLevel l)
+{
+    current() = min(l, detected());
+}
+
+const char *cpuFeature::name(simdLevel l)
+{
+    switch (l)
+    {
+    case simdLevel::sse4:
+        return "sse4";
+    case simdLevel::avx2:
+        return "avx2";
+    case simdLevel::avx512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
@@ -0,0 +1,222 @@
+#include "float4x4.h"
+#include "cpuFeature.h"
+#include <stdexcept>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FLOAT4X4_X86_SIMD
+#endif
+using namespace std;
+
+float4x4::float4x4(Matrix mat)
+{
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            m[i][j] = float(mat.getData(i, j));
+}
+
+float4x4 float4x4::identity()
+{
+    float4x4 res;
+    for (int i = 0; i < 4; i++)
+        res.m[i][i] = 1;
+    return res;
+}
+
+float4x4 float4x4::transpose() const
+{
+    float4x4 res;
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            res.m[i][j] = m[j][i];
+    return res;
+}
+
+// 左上 3x3 的余子式矩阵 c 与行列式，c / det 的转置即 3x3 的逆
+static double cofactor3(const float4x4 &a, double c[3][3])
+{
+    auto e = [&](int i, int j)
+    { return double(a.m[i][j]); };
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+        {
+            int i0 = (i + 1) % 3, i1 = (i + 2) % 3, j0 = (j + 1) % 3, j1 = (j + 2) % 3;
+            c[i][j] = e(i0, j0) * e(i1, j1) - e(i0, j1) * e(i1, j0);
+        }
+    return e(0, 0) * c[0][0] + e(0, 1) * c[0][1] + e(0, 2) * c[0][2];
+}
+
+float4x4 float4x4::affineInverse() const
+{
+    double c[3][3];
+    double det = cofactor3(*this, c);
+    if (det == 0)
+        throw logic_error("unable to inverse Martix");
+    float4x4 res;
+    for (int i = 0; i < 3; i++)
+    {
+        double t = 0;
+        for (int j = 0; j < 3; j++)
+        {
+            res.m[i][j] = float(c[j][i] / det);
+            t -= c[j][i] / det * m[j][3];
+        }
+        res.m[i][3] = float(t);
+    }
+    res.m[3][3] = 1;
+    return res;
+}
+
+float4x4 float4x4::normalMatrix() const
+{
+    double c[3][3];
+    double det = cofactor3(*this, c);
+    // 退化（缩放为 0）时法线本就无意义，直接用余子式矩阵，避免在顶点阶段抛异常
+    double s = det != 0 ? 1 / det : 1;
+    float4x4 res;
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            res.m[i][j] = float(c[i][j] * s);
+    return res;
+}
+
+static void mulScalar(const float4x4 &a, const float4x4 &b, float4x4 &res)
+{
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            for (int k = 0; k < 4; k++)
+                res.m[i][j] += a.m[i][k] * b.m[k][j];
+}
+
+static void transformScalar(const float4x4 &m, const vec4 *in, vec4 *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        vec4 p = in[i];
+        out[i] = {m.m[0][0] * p.x + m.m[0][1] * p.y + m.m[0][2] * p.z + m.m[0][3] * p.w,
+                  m.m[1][0] * p.x + m.m[1][1] * p.y + m.m[1][2] * p.z + m.m[1][3] * p.w,
+                  m.m[2][0] * p.x + m.m[2][1] * p.y + m.m[2][2] * p.z + m.m[2][3] * p.w,
+                  m.m[3][0] * p.x + m.m[3][1] * p.y + m.m[3][2] * p.z + m.m[3][3] * p.w};
+    }
+}
+
+#ifdef FLOAT4X4_X86_SIMD
+// 结果第 i 行 = sum_k a[i][k] * b 第 k 行
+__attribute__((target("sse4.2"))) static void mulSse4(const float4x4 &a, const float4x4 &b, float4x4 &res)
+{
+    __m128 row[4];
+    for (int k = 0; k < 4; k++)
+        row[k] = _mm_load_ps(b.m[k]);
+    for (int i = 0; i < 4; i++)
+    {
+        __m128 r = _mm_mul_ps(_mm_set1_ps(a.m[i][0]), row[0]);
+        for (int k = 1; k < 4; k++)
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.m[i][k]), row[k]));
+        _mm_store_ps(res.m[i], r);
+    }
+}
+
+// 批量变换都按列展开：m * p = col0 * p.x + col1 * p.y + col2 * p.z + col3 * p.w，
+// 列预先转置成行常驻寄存器，每个点只需 4 次广播与 4 次乘加，没有水平求和
+__attribute__((target("sse4.2"))) static void transformSse4(const float4x4 &m, const vec4 *in, vec4 *out, size_t n)
+{
+    float4x4 t = m.transpose();
+    __m128 c0 = _mm_load_ps(t.m[0]), c1 = _mm_load_ps(t.m[1]), c2 = _mm_load_ps(t.m[2]), c3 = _mm_load_ps(t.m[3]);
+    for (size_t i = 0; i < n; i++)
+    {
+        __m128 p = _mm_load_ps(&in[i].x);
+        __m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(p, p, 0x00));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(p, p, 0x55)));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(p, p, 0xaa)));
+        r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(p, p, 0xff)));
+        _mm_store_ps(&out[i].x, r);
+    }
+}
+
+// 每个 ymm 装两个点，两条 128 位通道各算一个
+__attribute__((target("avx2,fma"))) static void transformAvx2(const float4x4 &m, const vec4 *in, vec4 *out, size_t n)
+{
+    float4x4 t = m.transpose();
+    __m256 c0 = _mm256_broadcast_ps((const __m128 *)t.m[0]), c1 = _mm256_broadcast_ps((const __m128 *)t.m[1]);
+    __m256 c2 = _mm256_broadcast_ps((const __m128 *)t.m[2]), c3 = _mm256_broadcast_ps((const __m128 *)t.m[3]);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m256 p = _mm256_loadu_ps(&in[i].x);
+        __m256 r = _mm256_mul_ps(c0, _mm256_permute_ps(p, 0x00));
+        r = _mm256_fmadd_ps(c1, _mm256_permute_ps(p, 0x55), r);
+        r = _mm256_fmadd_ps(c2, _mm256_permute_ps(p, 0xaa), r);
+        r = _mm256_fmadd_ps(c3, _mm256_permute_ps(p, 0xff), r);
+        _mm256_storeu_ps(&out[i].x, r);
+    }
+    if (i < n)
+    {
+        __m128 p = _mm_load_ps(&in[i].x);
+        __m128 r = _mm_mul_ps(_mm256_castps256_ps128(c0), _mm_permute_ps(p, 0x00));
+        r = _mm_fmadd_ps(_mm256_castps256_ps128(c1), _mm_permute_ps(p, 0x55), r);
+        r = _mm_fmadd_ps(_mm256_castps256_ps128(c2), _mm_permute_ps(p, 0xaa), r);
+        r = _mm_fmadd_ps(_mm256_castps256_ps128(c3), _mm_permute_ps(p, 0xff), r);
+        _mm_store_ps(&out[i].x, r);
+    }
+}
+
+// 每个 zmm 装四个点，不足四个的尾部交给 AVX2
+__attribute__((target("avx512f,avx2,fma"))) static void transformAvx512(const float4x4 &m, const vec4 *in, vec4 *out, size_t n)
+{
+    float4x4 t = m.transpose();
+    __m512 c0 = _mm512_broadcast_f32x4(_mm_load_ps(t.m[0])), c1 = _mm512_broadcast_f32x4(_mm_load_ps(t.m[1]));
+    __m512 c2 = _mm512_broadcast_f32x4(_mm_load_ps(t.m[2])), c3 = _mm512_broadcast_f32x4(_mm_load_ps(t.m[3]));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m512 p = _mm512_loadu_ps(&in[i].x);
+        __m512 r = _mm512_mul_ps(c0, _mm512_permute_ps(p, 0x00));
+        r = _mm512_fmadd_ps(c1, _mm512_permute_ps(p, 0x55), r);
+        r = _mm512_fmadd_ps(c2, _mm512_permute_ps(p, 0xaa), r);
+        r = _mm512_fmadd_ps(c3, _mm512_permute_ps(p, 0xff), r);
+        _mm512_storeu_ps(&out[i].x, r);
+    }
+    transformAvx2(m, in + i, out + i, n - i);
+}
+#endif
+
+float4x4 float4x4::operator*(const float4x4 &b) const
+{
+    float4x4 res;
+#ifdef FLOAT4X4_X86_SIMD
+    if (cpuFeature::level() >= simdLevel::sse4)
+    {
+        mulSse4(*this, b, res);
+        return res;
+    }
+#endif
+    mulScalar(*this, b, res);
+    return res;
+}
+
+vec4 float4x4::operator*(const vec4 &v) const
+{
+    vec4 res;
+    transformPoints(*this, {&v, 1}, {&res, 1});
+    return res;
+}
+
+void transformPoints(const float4x4 &m, span<const vec4> in, span<vec4> out)
+{
+#ifdef FLOAT4X4_X86_SIMD
+    switch (cpuFeature::level())
+    {
+    case simdLevel::avx512:
+        transformAvx512(m, in.data(), out.data(), in.size());
+        return;
+    case simdLevel::avx2:
+        transformAvx2(m, in.data(), out.data(), in.size());
+        return;
+    case simdLevel::sse4:
+        transformSse4(m, in.data(), out.data(), in.size());
+        return;
+    default:
+        break;
+    }
+#endif
+    transformScalar(m, in.data(), out.data(), in.size());
+}
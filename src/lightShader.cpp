@@ -1,7 +1,12 @@
 #include "lightShader.h"
+#include "cpuFeature.h"
 #include <algorithm>
 #include <iostream>
 #include <cmath>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LIGHT_X86_SIMD
+#endif
 
 lightShader::lightShader()
 {
@@ -19,16 +24,228 @@ vec3 lightShader::operator()(vec3 xyz, vec3 normal, vec3 color, vec3 view_pos)
     vec3 view_dir = (view_pos - xyz).normalize();
     for (vec3 position : lightPos)
     {
-        double r = (position - xyz).len();
+        real r = (position - xyz).len();
         vec3 direction = (position - xyz).normalize();
         vec3 h = (direction + view_dir).normalize();
-        double intensity = I / r / r;
+        real intensity = I / r / r;
         res += ka * Ia * 255;
-        res += color * intensity * std::max(0.0,normal * direction);
-        res += ks * intensity * std::max(0.0, pow(normal * h, p)) * 255;
+        res += color * intensity * std::max(real(0), normal * direction);
+        // 高光 (n·h)^p 写成 exp(p ln(n·h))，指数低于 specularFloor 时直接跳过：
+        // 结果不到 2e-35，单精度下会落进非规格化数，后续运算极慢且对颜色没有贡献
+        real nh = normal * h, e = nh > 0 ? p * std::log(nh) : specularFloor;
+        if (e > specularFloor)
+            res += ks * intensity * std::exp(e) * 255;
     }
     for (int i = 0;i < 3;i++)
         if (res[i] > 255)
             res[i] = 255;
     return res;
 }
+
+
+#ifdef LIGHT_X86_SIMD
+// 各级别内核共用的单精度常量
+struct lightConstants
+{
+    float I, ambient[3], ks[3];
+    int p;            // 高光指数，按二进制拆分做整数次幂
+    float specCutoff; // n·h 低于它时高光按 0 计，避免连乘下溢成非规格化数
+    const std::vector<vec3> *lightPos;
+    float view[3];
+};
+
+__attribute__((target("sse4.2"))) static void shadeSse4(const lightConstants &k, fragmentBatch &b, int i)
+{
+    __m128 pos[3], nor[3], col[3], viewDir[3], res[3];
+    for (int c = 0; c < 3; c++)
+    {
+        pos[c] = _mm_load_ps(b.pos[c] + i);
+        nor[c] = _mm_load_ps(b.nor[c] + i);
+        col[c] = _mm_load_ps(b.color[c] + i);
+        viewDir[c] = _mm_sub_ps(_mm_set1_ps(k.view[c]), pos[c]);
+        res[c] = _mm_setzero_ps();
+    }
+    __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(viewDir[0], viewDir[0]), _mm_mul_ps(viewDir[1], viewDir[1])), _mm_mul_ps(viewDir[2], viewDir[2])));
+    for (int c = 0; c < 3; c++)
+        viewDir[c] = _mm_div_ps(viewDir[c], len);
+
+    for (vec3 light : *k.lightPos)
+    {
+        __m128 dir[3], h[3];
+        for (int c = 0; c < 3; c++)
+            dir[c] = _mm_sub_ps(_mm_set1_ps(float(light[c])), pos[c]);
+        __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dir[0], dir[0]), _mm_mul_ps(dir[1], dir[1])), _mm_mul_ps(dir[2], dir[2]));
+        __m128 r = _mm_sqrt_ps(r2);
+        for (int c = 0; c < 3; c++)
+        {
+            dir[c] = _mm_div_ps(dir[c], r);
+            h[c] = _mm_add_ps(dir[c], viewDir[c]);
+        }
+        __m128 hLen = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(h[0], h[0]), _mm_mul_ps(h[1], h[1])), _mm_mul_ps(h[2], h[2])));
+        __m128 intensity = _mm_div_ps(_mm_set1_ps(k.I), r2);
+        __m128 nDotL = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nor[0], dir[0]), _mm_mul_ps(nor[1], dir[1])), _mm_mul_ps(nor[2], dir[2]));
+        __m128 nDotH = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nor[0], h[0]), _mm_mul_ps(nor[1], h[1])), _mm_mul_ps(nor[2], h[2])), hLen);
+        __m128 spec = _mm_set1_ps(1), base = nDotH;
+        base = _mm_and_ps(base, _mm_cmpge_ps(base, _mm_set1_ps(k.specCutoff)));
+        for (int e = k.p; e; e >>= 1)
+        {
+            if (e & 1)
+                spec = _mm_mul_ps(spec, base);
+            base = _mm_mul_ps(base, base);
+        }
+        __m128 diffuse = _mm_mul_ps(intensity, _mm_max_ps(nDotL, _mm_setzero_ps()));
+        spec = _mm_mul_ps(_mm_mul_ps(intensity, _mm_max_ps(spec, _mm_setzero_ps())), _mm_set1_ps(255));
+        for (int c = 0; c < 3; c++)
+        {
+            res[c] = _mm_add_ps(res[c], _mm_set1_ps(k.ambient[c]));
+            res[c] = _mm_add_ps(res[c], _mm_mul_ps(col[c], diffuse));
+            res[c] = _mm_add_ps(res[c], _mm_mul_ps(_mm_set1_ps(k.ks[c]), spec));
+        }
+    }
+    for (int c = 0; c < 3; c++)
+        _mm_store_ps(b.color[c] + i, _mm_min_ps(res[c], _mm_set1_ps(255)));
+}
+
+__attribute__((target("avx2,fma"))) static void shadeAvx2(const lightConstants &k, fragmentBatch &b, int i)
+{
+    __m256 pos[3], nor[3], col[3], viewDir[3], res[3];
+    for (int c = 0; c < 3; c++)
+    {
+        pos[c] = _mm256_load_ps(b.pos[c] + i);
+        nor[c] = _mm256_load_ps(b.nor[c] + i);
+        col[c] = _mm256_load_ps(b.color[c] + i);
+        viewDir[c] = _mm256_sub_ps(_mm256_set1_ps(k.view[c]), pos[c]);
+        res[c] = _mm256_setzero_ps();
+    }
+    __m256 len = _mm256_sqrt_ps(_mm256_fmadd_ps(viewDir[0], viewDir[0], _mm256_fmadd_ps(viewDir[1], viewDir[1], _mm256_mul_ps(viewDir[2], viewDir[2]))));
+    for (int c = 0; c < 3; c++)
+        viewDir[c] = _mm256_div_ps(viewDir[c], len);
+
+    for (vec3 light : *k.lightPos)
+    {
+        __m256 dir[3], h[3];
+        for (int c = 0; c < 3; c++)
+            dir[c] = _mm256_sub_ps(_mm256_set1_ps(float(light[c])), pos[c]);
+        __m256 r2 = _mm256_fmadd_ps(dir[0], dir[0], _mm256_fmadd_ps(dir[1], dir[1], _mm256_mul_ps(dir[2], dir[2])));
+        __m256 r = _mm256_sqrt_ps(r2);
+        for (int c = 0; c < 3; c++)
+        {
+            dir[c] = _mm256_div_ps(dir[c], r);
+            h[c] = _mm256_add_ps(dir[c], viewDir[c]);
+        }
+        __m256 hLen = _mm256_sqrt_ps(_mm256_fmadd_ps(h[0], h[0], _mm256_fmadd_ps(h[1], h[1], _mm256_mul_ps(h[2], h[2]))));
+        __m256 intensity = _mm256_div_ps(_mm256_set1_ps(k.I), r2);
+        __m256 nDotL = _mm256_fmadd_ps(nor[0], dir[0], _mm256_fmadd_ps(nor[1], dir[1], _mm256_mul_ps(nor[2], dir[2])));
+        __m256 nDotH = _mm256_div_ps(_mm256_fmadd_ps(nor[0], h[0], _mm256_fmadd_ps(nor[1], h[1], _mm256_mul_ps(nor[2], h[2]))), hLen);
+        __m256 spec = _mm256_set1_ps(1), base = nDotH;
+        base = _mm256_and_ps(base, _mm256_cmp_ps(base, _mm256_set1_ps(k.specCutoff), _CMP_GE_OQ));
+        for (int e = k.p; e; e >>= 1)
+        {
+            if (e & 1)
+                spec = _mm256_mul_ps(spec, base);
+            base = _mm256_mul_ps(base, base);
+        }
+        __m256 diffuse = _mm256_mul_ps(intensity, _mm256_max_ps(nDotL, _mm256_setzero_ps()));
+        spec = _mm256_mul_ps(_mm256_mul_ps(intensity, _mm256_max_ps(spec, _mm256_setzero_ps())), _mm256_set1_ps(255));
+        for (int c = 0; c < 3; c++)
+        {
+            res[c] = _mm256_add_ps(res[c], _mm256_set1_ps(k.ambient[c]));
+            res[c] = _mm256_fmadd_ps(col[c], diffuse, res[c]);
+            res[c] = _mm256_fmadd_ps(_mm256_set1_ps(k.ks[c]), spec, res[c]);
+        }
+    }
+    for (int c = 0; c < 3; c++)
+        _mm256_store_ps(b.color[c] + i, _mm256_min_ps(res[c], _mm256_set1_ps(255)));
+}
+
+__attribute__((target("avx512f,avx512dq,fma"))) static void shadeAvx512(const lightConstants &k, fragmentBatch &b, int i)
+{
+    __m512 pos[3], nor[3], col[3], viewDir[3], res[3];
+    for (int c = 0; c < 3; c++)
+    {
+        pos[c] = _mm512_load_ps(b.pos[c] + i);
+        nor[c] = _mm512_load_ps(b.nor[c] + i);
+        col[c] = _mm512_load_ps(b.color[c] + i);
+        viewDir[c] = _mm512_sub_ps(_mm512_set1_ps(k.view[c]), pos[c]);
+        res[c] = _mm512_setzero_ps();
+    }
+    __m512 len = _mm512_sqrt_ps(_mm512_fmadd_ps(viewDir[0], viewDir[0], _mm512_fmadd_ps(viewDir[1], viewDir[1], _mm512_mul_ps(viewDir[2], viewDir[2]))));
+    for (int c = 0; c < 3; c++)
+        viewDir[c] = _mm512_div_ps(viewDir[c], len);
+
+    for (vec3 light : *k.lightPos)
+    {
+        __m512 dir[3], h[3];
+        for (int c = 0; c < 3; c++)
+            dir[c] = _mm512_sub_ps(_mm512_set1_ps(float(light[c])), pos[c]);
+        __m512 r2 = _mm512_fmadd_ps(dir[0], dir[0], _mm512_fmadd_ps(dir[1], dir[1], _mm512_mul_ps(dir[2], dir[2])));
+        __m512 r = _mm512_sqrt_ps(r2);
+        for (int c = 0; c < 3; c++)
+        {
+            dir[c] = _mm512_div_ps(dir[c], r);
+            h[c] = _mm512_add_ps(dir[c], viewDir[c]);
+        }
+        __m512 hLen = _mm512_sqrt_ps(_mm512_fmadd_ps(h[0], h[0], _mm512_fmadd_ps(h[1], h[1], _mm512_mul_ps(h[2], h[2]))));
+        __m512 intensity = _mm512_div_ps(_mm512_set1_ps(k.I), r2);
+        __m512 nDotL = _mm512_fmadd_ps(nor[0], dir[0], _mm512_fmadd_ps(nor[1], dir[1], _mm512_mul_ps(nor[2], dir[2])));
+        __m512 nDotH = _mm512_div_ps(_mm512_fmadd_ps(nor[0], h[0], _mm512_fmadd_ps(nor[1], h[1], _mm512_mul_ps(nor[2], h[2]))), hLen);
+        __m512 spec = _mm512_set1_ps(1), base = nDotH;
+        base = _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(base, _mm512_set1_ps(k.specCutoff), _CMP_GE_OQ), base);
+        for (int e = k.p; e; e >>= 1)
+        {
+            if (e & 1)
+                spec = _mm512_mul_ps(spec, base);
+            base = _mm512_mul_ps(base, base);
+        }
+        __m512 diffuse = _mm512_mul_ps(intensity, _mm512_max_ps(nDotL, _mm512_setzero_ps()));
+        spec = _mm512_mul_ps(_mm512_mul_ps(intensity, _mm512_max_ps(spec, _mm512_setzero_ps())), _mm512_set1_ps(255));
+        for (int c = 0; c < 3; c++)
+        {
+            res[c] = _mm512_add_ps(res[c], _mm512_set1_ps(k.ambient[c]));
+            res[c] = _mm512_fmadd_ps(col[c], diffuse, res[c]);
+            res[c] = _mm512_fmadd_ps(_mm512_set1_ps(k.ks[c]), spec, res[c]);
+        }
+    }
+    for (int c = 0; c < 3; c++)
+        _mm512_store_ps(b.color[c] + i, _mm512_min_ps(res[c], _mm512_set1_ps(255)));
+}
+#endif
+
+void lightShader::operator()(fragmentBatch &batch, vec3 view_pos)
+{
+    int i = 0;
+#ifdef LIGHT_X86_SIMD
+    simdLevel level = cpuFeature::level();
+    // 向量版本用平方-乘法求幂，只支持非负整数指数
+    if (level != simdLevel::scalar && p >= 0 && p <= 1 << 16 && p == std::floor(p))
+    {
+        lightConstants k;
+        k.I = float(I);
+        k.p = int(p);
+        k.specCutoff = k.p ? float(std::exp(specularFloor / p)) : 0;
+        k.lightPos = &lightPos;
+        for (int c = 0; c < 3; c++)
+        {
+            k.ambient[c] = float(ka[c] * Ia * 255);
+            k.ks[c] = float(ks[c]);
+            k.view[c] = float(view_pos[c]);
+        }
+        if (level == simdLevel::avx512)
+            for (; i + 16 <= batch.count; i += 16)
+                shadeAvx512(k, batch, i);
+        if (level >= simdLevel::avx2)
+            for (; i + 8 <= batch.count; i += 8)
+                shadeAvx2(k, batch, i);
+        for (; i + 4 <= batch.count; i += 4)
+            shadeSse4(k, batch, i);
+    }
+#endif
+    for (; i < batch.count; i++)
+    {
+        vec3 c = (*this)(vec3(batch.pos[0][i], batch.pos[1][i], batch.pos[2][i]),
+                         vec3(batch.nor[0][i], batch.nor[1][i], batch.nor[2][i]),
+                         vec3(batch.color[0][i], batch.color[1][i], batch.color[2][i]), view_pos);
+        for (int k = 0; k < 3; k++)
+            batch.color[k][i] = float(c[k]);
+    }
+}
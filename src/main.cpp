@@ -5,12 +5,13 @@
 #include "vec.h"
 #include "rasterizer.h"
 #include "model.h"
-#include "OBJ_Loader.h"
 #include <iostream>
 #include <random>
 #include <time.h>
 #include <cmath>
 #include <any>
+#include <queue>
+#include <chrono>
 // #undef main
 using namespace std;
 
@@ -18,6 +19,7 @@ const int width = 700, height = 700;
 camera cam;
 simpleWindow wnd;
 rasterizer ras(width, height);
+assetManager assets;
 float getfps()
 {  
     using fsec = chrono::time_point<std::chrono::_V2::system_clock, chrono::duration<double>>;
@@ -33,6 +35,12 @@ float getfps()
 }
 int main(int argc,char* argv[])
 {
+    // --analyze：载入时统计网格优化前后的 ACMR / ATVR / 过度绘制，就绪后打印
+    bool analyze = false;
+    for (int i = 1; i < argc; i++)
+        if (string(argv[i]) == "--analyze")
+            analyze = true;
+
     wnd.create("hello world", width, height);
     ras.setBkColor(220, 230, 210);
 
@@ -43,47 +51,33 @@ int main(int argc,char* argv[])
     ras.addLight(vec3(20, 20, 20));
     ras.addLight(vec3(-20, 20, 0));
 
-    model mod;
+    // 模型与纹理在后台载入，第一帧不等它们；载入完成前在估计的位置画一个灰色方块
+    model box = model::cube();
+    box.modelMatrix = model::scaling(vec3(1.15, 1.15, 1.15)) * model::translation(vec3(-0.5, -0.5, 0.5));
+    box.setColor(180, 180, 180);
+    ras.setPlaceholder(&box);
 
     // mod = model::plain();
     // mod = mod.scale(vec3(2, 2, 2));
     // mod = mod.translate(vec3(-1, -1, 0));
-    // for (int i = 0; i < 2; i++)
-    //     mod.getTriangle(i).setColor(155, 0, 100);
+    // mod.setColor(155, 0, 100);
 
     // mod = model::cube();
     // mod.translate(vec3(-1, -1, 0));
     // mod.scale(vec3(2, 2, 2));
-    // for (int i = 0; i < 12; i++)
-    //     mod.getTriangle(i).setColor(155, 0, 100);
-
-    objl::Loader Loader;
-    Loader.LoadFile("../models/spot/spot_triangulated_good.obj");
-    for (auto mesh : Loader.LoadedMeshes)
-    {
-        for (int i = 0; i < mesh.Vertices.size(); i += 3)
-        {
-            Triangle t;
-            t.setColor(255, 255, 255);
-            for (int j = 0; j < 3; j++)
-            {
-                t.setVertex(vec3(mesh.Vertices[i + j].Position.X, mesh.Vertices[i + j].Position.Y, mesh.Vertices[i + j].Position.Z), j);
-                t.setNormal(vec3(mesh.Vertices[i + j].Normal.X, mesh.Vertices[i + j].Normal.Y, mesh.Vertices[i + j].Normal.Z), j);
-                t.setTexCoord(mesh.Vertices[i + j].TextureCoordinate.X, mesh.Vertices[i + j].TextureCoordinate.Y, j);
-            }
-            mod.addTriangle(t);
-        }
-    }
-    mod.loadTexture("../models/spot/spot_texture.png");
-    mod = mod.scale(vec3(2.5, 2.5, 2.5));
-    mod = mod.rotate(140, vec3(0, 1, 0));
+    // mod.setColor(155, 0, 100);
 
+    modelHandle mod = assets.loadModel("../models/spot/spot_triangulated_good.obj", "../models/spot/spot_texture.png", 1, analyze);
+    mod->scale(vec3(2.5, 2.5, 2.5));
+    mod->rotate(140, vec3(0, 1, 0));
     ras.pushModel(mod);
+    bool reported = false;
+    auto lastPrint = chrono::steady_clock::now();
 
     while (!wnd.shouldClose())
     {
         char key = wnd.getKey();
-
+        // 模型矩阵与剔除方式在提交时取快照，修改它们不必等在飞行中的帧
         // if (key == 'A' || key == 'D')
         // {
         //     double deg = key == 'A' ? 1 : -1;
@@ -93,11 +87,11 @@ int main(int argc,char* argv[])
         {
             // cam.transform(vec3(-1, 0, 0));
             // mod = mod.rotate(-5, vec3(0, 1, 0));
-            mod = mod.translate({1, 0, 0});
+            mod->translate({1, 0, 0});
         }
         else if (key == 'd')
         {
-            mod = mod.translate({-1, 0, 0});
+            mod->translate({-1, 0, 0});
             // cam.transform(vec3(1, 0, 0));
             // mod = mod.rotate(5, vec3(0, 1, 0));
         }
@@ -109,6 +103,24 @@ int main(int argc,char* argv[])
         {
             cam.transform(vec3(0, 0, 0.1));
         }
+        else if (key == 'v')
+        {
+            bool vis = ras.getPipeline() == renderPipeline::visibility;
+            ras.setPipeline(vis ? renderPipeline::forward : renderPipeline::visibility);
+        }
+        else if (key == 'p')
+        {
+            bool pre = ras.getPipeline() == renderPipeline::depthPrepass;
+            ras.setPipeline(pre ? renderPipeline::forward : renderPipeline::depthPrepass);
+        }
+        else if (key == 'f')
+        {
+            ras.setFramesInFlight(ras.getFramesInFlight() == 1 ? 2 : 1);
+        }
+        else if (key == 'c')
+        {
+            mod->cull = mod->cull == cullMode::back ? cullMode::front : mod->cull == cullMode::front ? cullMode::none : cullMode::back;
+        }
         else if (key == 27)
             break;
         // mod.rotate(1, vec3(0.5, 0.7, 0.3));
@@ -119,7 +131,29 @@ int main(int argc,char* argv[])
         wnd.show(data);    // 消息处理循环
 
         // this_thread::sleep_for(100ms);
-        cout << '\r' << getfps() << "      ";
+        if (!reported && mod->getState() == assetState::failed)
+        {
+            cerr << "failed to load model\n";
+            reported = true;
+        }
+        else if (!reported && mod->ready())
+        {
+            if (const meshAnalysis *st = mod->getAnalysis())
+            {
+                cout << "\nbefore: acmr " << st->before.acmr << "  atvr " << st->before.atvr << "  overdraw " << st->before.overdraw
+                     << "\nafter:  acmr " << st->after.acmr << "  atvr " << st->after.atvr << "  overdraw " << st->after.overdraw << endl;
+            }
+            reported = true;
+        }
+        // 帧率每帧都要记录，但状态行每秒只刷新一次
+        float fps = getfps();
+        auto now = chrono::steady_clock::now();
+        if (now - lastPrint >= 1s)
+        {
+            lastPrint = now;
+            cout << '\r' << fps << "  shaded/px " << ras.getStats().shadedPerPixel() << "  culled " << ras.getStats().culled << "      " << flush;
+        }
     }
+    ras.finish();
     return 0;
 }
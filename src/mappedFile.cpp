@@ -0,0 +1,87 @@
+#include "mappedFile.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool mappedFile::open(const char *path)
+{
+    close();
+#ifdef _WIN32
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        file = nullptr;
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        close();
+        return false;
+    }
+    len = size_t(size.QuadPart);
+    if (len)
+    {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        ptr = mapping ? (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!ptr)
+        {
+            close();
+            return false;
+        }
+    }
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    len = size_t(st.st_size);
+    if (len)
+    {
+        void *p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            ::close(fd);
+            len = 0;
+            return false;
+        }
+        // 解析是从头到尾顺序读，提示内核加大预读
+        madvise(p, len, MADV_SEQUENTIAL);
+        ptr = (const char *)p;
+    }
+    // 映射建立后不再需要文件描述符
+    ::close(fd);
+#endif
+    opened = true;
+    return true;
+}
+
+void mappedFile::close()
+{
+#ifdef _WIN32
+    if (ptr)
+        UnmapViewOfFile(ptr);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+    file = mapping = nullptr;
+#else
+    if (ptr)
+        munmap((void *)ptr, len);
+#endif
+    ptr = nullptr;
+    len = 0;
+    opened = false;
+}
@@ -0,0 +1,256 @@
+#include "meshCache.h"
+#include "mappedFile.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <memory>
+using namespace std;
+
+static constexpr char cacheMagic[8] = {'R', 'A', 'S', 'M', 'E', 'S', 'H', 0};
+static constexpr uint32_t byteOrderMark = 0x01020304; // 按本机字节序写入，读到的值不同说明字节序不符
+static constexpr uint64_t sectionAlign = 64;
+
+enum cacheStream
+{
+    streamPos,
+    streamNor,
+    streamU,
+    streamV,
+    streamR,
+    streamG,
+    streamB,
+    streamIndex,
+    streamCount,
+};
+
+struct cacheHeader
+{
+    char magic[8];
+    uint32_t version, byteOrder;
+    uint64_t sourceSize;
+    int64_t sourceTime; // 源文件修改时间（file_time_type 的计数）
+    uint64_t vertexCount, indexCount;
+    uint32_t indexSize, reserved; // 每个下标的字节数，2 或 4
+    uint64_t streamOffset[streamCount];
+    uint64_t meshOffset, meshCount;
+    uint64_t stringOffset, stringSize;
+    uint32_t materialLibOffset, materialLibSize; // 在字符串表中的位置
+    meshBounds bounds;                           // 整个模型
+};
+
+struct meshRecord
+{
+    uint32_t nameOffset, nameSize, materialOffset, materialSize;
+    uint32_t firstIndex, indexCount;
+    meshBounds bounds;
+};
+
+static uint64_t alignUp(uint64_t x)
+{
+    return (x + sectionAlign - 1) / sectionAlign * sectionAlign;
+}
+
+static bool sourceStamp(const char *objPath, uint64_t &size, int64_t &time)
+{
+    error_code ec;
+    size = filesystem::file_size(objPath, ec);
+    if (ec)
+        return false;
+    time = filesystem::last_write_time(objPath, ec).time_since_epoch().count();
+    return !ec;
+}
+
+static size_t elementSize(int s, uint32_t indexSize)
+{
+    switch (s)
+    {
+    case streamPos:
+    case streamNor:
+        return sizeof(vec4);
+    case streamU:
+    case streamV:
+        return sizeof(float);
+    case streamIndex:
+        return indexSize;
+    default:
+        return sizeof(uint8_t);
+    }
+}
+
+string meshCache::pathFor(const char *objPath)
+{
+    return string(objPath) + ".mesh";
+}
+
+bool meshCache::save(const char *objPath, const vertexBuffer &verts, const indexBuffer &indices,
+                     const vector<objMesh> &meshes, const string &materialLib)
+{
+    cacheHeader h{};
+    memcpy(h.magic, cacheMagic, sizeof(cacheMagic));
+    h.version = version;
+    h.byteOrder = byteOrderMark;
+    if (!sourceStamp(objPath, h.sourceSize, h.sourceTime))
+        return false;
+    h.vertexCount = verts.size();
+    h.indexCount = indices.size();
+    h.indexSize = indices.i16.size() ? sizeof(uint16_t) : sizeof(uint32_t);
+    h.bounds = computeBounds(verts.pos.data(), nullptr, verts.size());
+
+    string strings = materialLib;
+    h.materialLibOffset = 0;
+    h.materialLibSize = uint32_t(materialLib.size());
+    vector<meshRecord> records;
+    for (const objMesh &m : meshes)
+    {
+        meshRecord r{uint32_t(strings.size()), uint32_t(m.name.size()), 0, uint32_t(m.material.size()), m.firstIndex, m.indexCount, m.bounds};
+        strings += m.name;
+        r.materialOffset = uint32_t(strings.size());
+        strings += m.material;
+        records.push_back(r);
+    }
+
+    const void *data[streamCount] = {verts.pos.data(), verts.nor.data(), verts.u.data(), verts.v.data(),
+                                     verts.r.data(), verts.g.data(), verts.b.data(),
+                                     h.indexSize == sizeof(uint16_t) ? (const void *)indices.i16.data() : indices.i32.data()};
+    uint64_t off = alignUp(sizeof(h));
+    for (int s = 0; s < streamCount; s++)
+    {
+        h.streamOffset[s] = off;
+        off = alignUp(off + (s == streamIndex ? h.indexCount : h.vertexCount) * elementSize(s, h.indexSize));
+    }
+    h.meshOffset = off;
+    h.meshCount = records.size();
+    h.stringOffset = alignUp(off + records.size() * sizeof(meshRecord));
+    h.stringSize = strings.size();
+
+    string path = pathFor(objPath), tmp = path + ".tmp";
+    {
+        ofstream out(tmp, ios::binary | ios::trunc);
+        if (!out)
+            return false;
+        uint64_t at = 0;
+        auto put = [&](uint64_t where, const void *p, size_t n)
+        {
+            static const char zeros[sectionAlign] = {};
+            out.write(zeros, streamsize(where - at));
+            out.write((const char *)p, streamsize(n));
+            at = where + n;
+        };
+        put(0, &h, sizeof(h));
+        for (int s = 0; s < streamCount; s++)
+            put(h.streamOffset[s], data[s], (s == streamIndex ? h.indexCount : h.vertexCount) * elementSize(s, h.indexSize));
+        put(h.meshOffset, records.data(), records.size() * sizeof(meshRecord));
+        put(h.stringOffset, strings.data(), strings.size());
+        if (!out.flush())
+        {
+            out.close();
+            filesystem::remove(tmp);
+            return false;
+        }
+    }
+    error_code ec;
+    filesystem::rename(tmp, path, ec);
+    if (ec)
+        filesystem::remove(tmp, ec);
+    return !ec;
+}
+
+// 与 load 相同的头部校验，文件内容本身由 load 再检查
+static bool headerValid(const cacheHeader &h, const char *objPath)
+{
+    uint64_t size;
+    int64_t time;
+    return !memcmp(h.magic, cacheMagic, sizeof(cacheMagic)) && h.version == meshCache::version && h.byteOrder == byteOrderMark &&
+           (h.indexSize == sizeof(uint16_t) || h.indexSize == sizeof(uint32_t)) &&
+           sourceStamp(objPath, size, time) && size == h.sourceSize && time == h.sourceTime;
+}
+
+bool meshCache::peekBounds(const char *objPath, meshBounds &bounds)
+{
+    cacheHeader h;
+    ifstream in(pathFor(objPath), ios::binary);
+    if (!in.read((char *)&h, sizeof(h)) || !headerValid(h, objPath))
+        return false;
+    bounds = h.bounds;
+    return true;
+}
+
+// 下标缓冲中的最大值，空缓冲返回 0
+template <typename T>
+static uint32_t maxIndex(const T *idx, size_t count, ThreadPool &pool)
+{
+    return pool.parallelReduce(0, count, 0, uint32_t(0), [idx](size_t lo, size_t hi, uint32_t acc)
+                               {
+        for (size_t i = lo; i < hi; i++)
+            acc = max<uint32_t>(acc, idx[i]);
+        return acc; }, [](uint32_t a, uint32_t b)
+                               { return max(a, b); });
+}
+
+bool meshCache::load(const char *objPath, vertexBuffer &verts, indexBuffer &indices,
+                     vector<objMesh> &meshes, string &materialLib, meshBounds &bounds, ThreadPool &pool)
+{
+    auto file = make_shared<mappedFile>();
+    if (!file->open(pathFor(objPath).c_str()) || file->size() < sizeof(cacheHeader))
+        return false;
+    cacheHeader h;
+    memcpy(&h, file->data(), sizeof(h));
+    if (!headerValid(h, objPath))
+        return false;
+
+    // 每一段都必须完整落在文件内；流还必须对齐，才能直接当作对齐数组使用
+    uint64_t fileSize = file->size();
+    auto inFile = [&](uint64_t off, uint64_t count, uint64_t elem)
+    { return off <= fileSize && (elem == 0 || count <= (fileSize - off) / elem); };
+    for (int s = 0; s < streamCount; s++)
+        if (h.streamOffset[s] % sectionAlign || !inFile(h.streamOffset[s], s == streamIndex ? h.indexCount : h.vertexCount, elementSize(s, h.indexSize)))
+            return false;
+    if (h.vertexCount > UINT32_MAX || (h.indexSize == sizeof(uint16_t) && h.vertexCount > 65536) || h.indexCount % 3 ||
+        h.meshOffset % alignof(meshRecord) ||
+        !inFile(h.meshOffset, h.meshCount, sizeof(meshRecord)) || !inFile(h.stringOffset, h.stringSize, 1) ||
+        uint64_t(h.materialLibOffset) + h.materialLibSize > h.stringSize)
+        return false;
+
+    const char *base = file->data();
+    string_view strings(base + h.stringOffset, h.stringSize);
+    const meshRecord *records = (const meshRecord *)(base + h.meshOffset);
+    vector<objMesh> table;
+    for (uint64_t i = 0; i < h.meshCount; i++)
+    {
+        const meshRecord &r = records[i];
+        if (uint64_t(r.nameOffset) + r.nameSize > h.stringSize || uint64_t(r.materialOffset) + r.materialSize > h.stringSize ||
+            uint64_t(r.firstIndex) + r.indexCount > h.indexCount)
+            return false;
+        table.push_back({string(strings.substr(r.nameOffset, r.nameSize)), string(strings.substr(r.materialOffset, r.materialSize)),
+                         r.firstIndex, r.indexCount, r.bounds});
+    }
+
+    auto at = [&](int s)
+    { return base + h.streamOffset[s]; };
+    size_t n = size_t(h.vertexCount);
+    // 手改或损坏的缓存可能通过上面的检查，越界下标会让顶点阶段与 getTriangle 读到映射之外
+    if (h.indexCount)
+    {
+        uint32_t hi = h.indexSize == sizeof(uint16_t) ? maxIndex((const uint16_t *)at(streamIndex), size_t(h.indexCount), pool)
+                                                       : maxIndex((const uint32_t *)at(streamIndex), size_t(h.indexCount), pool);
+        if (hi >= n)
+            return false;
+    }
+    verts.pos.attach((const vec4 *)at(streamPos), n, file);
+    verts.nor.attach((const vec4 *)at(streamNor), n, file);
+    verts.u.attach((const float *)at(streamU), n, file);
+    verts.v.attach((const float *)at(streamV), n, file);
+    verts.r.attach((const uint8_t *)at(streamR), n, file);
+    verts.g.attach((const uint8_t *)at(streamG), n, file);
+    verts.b.attach((const uint8_t *)at(streamB), n, file);
+    indices = {};
+    if (h.indexSize == sizeof(uint16_t))
+        indices.i16.attach((const uint16_t *)at(streamIndex), size_t(h.indexCount), file);
+    else
+        indices.i32.attach((const uint32_t *)at(streamIndex), size_t(h.indexCount), file);
+    meshes = move(table);
+    materialLib = strings.substr(h.materialLibOffset, h.materialLibSize);
+    bounds = h.bounds;
+    return true;
+}
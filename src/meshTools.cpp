@@ -0,0 +1,589 @@
+#include "meshTools.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
+using namespace std;
+
+static constexpr size_t blockSize = 1 << 14;    // 统计、编号与输出按块并行
+static constexpr size_t minPartition = 1 << 12; // 每个哈希分区至少覆盖的顶点数
+static constexpr size_t maxPartitions = 256;
+static constexpr uint32_t none = UINT32_MAX;
+static constexpr int lruSize = 32;          // Forsyth 打分模拟的缓存大小
+static constexpr int fifoSize = 16;         // 切簇与 ACMR 统计模拟的 FIFO 缓存大小
+static constexpr float clusterSlack = 1.05f; // 簇内 ACMR 不超过整段 ACMR 的倍数
+static constexpr int overdrawGrid = 256;
+
+// 比较用的键：浮点数先加 +0 把 -0 变成 +0，再按位比较
+struct weldKey
+{
+    uint32_t w[11];
+    bool operator==(const weldKey &o) const { return !memcmp(w, o.w, sizeof(w)); }
+};
+
+static uint32_t floatBits(float f)
+{
+    f += 0.0f;
+    uint32_t b;
+    memcpy(&b, &f, sizeof(b));
+    return b;
+}
+
+static weldKey keyOf(const vertexBuffer &vb, size_t i)
+{
+    const vec4 &p = vb.pos[i], &n = vb.nor[i];
+    return {{floatBits(p.x), floatBits(p.y), floatBits(p.z), floatBits(p.w), floatBits(n.x), floatBits(n.y), floatBits(n.z),
+             floatBits(n.w), floatBits(vb.u[i]), floatBits(vb.v[i]), uint32_t(vb.r[i]) | uint32_t(vb.g[i]) << 8 | uint32_t(vb.b[i]) << 16}};
+}
+
+static uint64_t hashKey(const weldKey &k)
+{
+    uint64_t h = 0x9e3779b97f4a7c15ull;
+    for (uint32_t w : k.w)
+    {
+        h ^= w;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 29;
+    }
+    // splitmix64 收尾，让高位也充分混合（分区用高 32 位，表内定位用低位）
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+template <class T>
+static void compactStream(meshStream<T> &s, const vector<uint32_t> &kept, ThreadPool &pool)
+{
+    alignedVector<T> out(kept.size());
+    const T *src = s.data();
+    pool.parallelFor(0, kept.size(), blockSize, [&](size_t lo, size_t hi)
+                     {
+        for (size_t i = lo; i < hi; i++)
+            out[i] = src[kept[i]]; });
+    s = move(out);
+}
+
+size_t weldVertices(vertexBuffer &verts, alignedVector<uint32_t> &indices, ThreadPool &pool)
+{
+    size_t n = verts.size();
+    if (n < 2)
+        return n;
+    size_t parts = clamp<size_t>(n / minPartition, 1, maxPartitions);
+    size_t blocks = (n + blockSize - 1) / blockSize;
+
+    // 1. 各顶点求哈希，同时按块统计落入各分区的顶点数
+    vector<uint64_t> hash(n);
+    vector<uint32_t> partOf(n);
+    vector<size_t> cursor(blocks * parts, 0); // [block][part]
+    pool.parallelFor(0, blocks, 1, [&](size_t lo, size_t hi)
+                     {
+        for (size_t b = lo; b < hi; b++)
+            for (size_t i = b * blockSize; i < min(n, (b + 1) * blockSize); i++)
+            {
+                hash[i] = hashKey(keyOf(verts, i));
+                partOf[i] = uint32_t((hash[i] >> 32) * parts >> 32);
+                cursor[b * parts + partOf[i]]++;
+            } });
+
+    // 2. 按分区做稳定的计数排序，分区内顶点保持原有顺序，第一个遇到的就是最早出现的
+    vector<size_t> partBegin(parts + 1, 0);
+    for (size_t p = 0, off = 0; p < parts; p++)
+    {
+        partBegin[p] = off;
+        for (size_t b = 0; b < blocks; b++)
+            off += exchange(cursor[b * parts + p], off);
+        partBegin[p + 1] = off;
+    }
+    vector<uint32_t> order(n);
+    pool.parallelFor(0, blocks, 1, [&](size_t lo, size_t hi)
+                     {
+        for (size_t b = lo; b < hi; b++)
+            for (size_t i = b * blockSize; i < min(n, (b + 1) * blockSize); i++)
+                order[cursor[b * parts + partOf[i]]++] = uint32_t(i); });
+
+    // 3. 各分区用开放寻址表去重，canon[i] 为与 i 相同的最早顶点
+    vector<uint32_t> canon(n);
+    pool.parallelFor(0, parts, 1, [&](size_t lo, size_t hi)
+                     {
+        vector<uint32_t> table;
+        for (size_t p = lo; p < hi; p++)
+        {
+            size_t count = partBegin[p + 1] - partBegin[p], cap = 16;
+            while (cap < count * 2)
+                cap *= 2;
+            table.assign(cap, none);
+            for (size_t k = partBegin[p]; k < partBegin[p + 1]; k++)
+            {
+                uint32_t i = order[k];
+                weldKey key = keyOf(verts, i);
+                size_t slot = hash[i] & (cap - 1);
+                while (table[slot] != none && (hash[table[slot]] != hash[i] || !(keyOf(verts, table[slot]) == key)))
+                    slot = (slot + 1) & (cap - 1);
+                if (table[slot] == none)
+                    table[slot] = i;
+                canon[i] = table[slot];
+            }
+        } });
+    hash = {};
+    partOf = {};
+    order = {};
+
+    // 4. 保留的顶点按原顺序编号：先数各块保留数，前缀和后各块并行写出新编号
+    vector<size_t> blockBase(blocks + 1, 0);
+    pool.parallelFor(0, blocks, 1, [&](size_t lo, size_t hi)
+                     {
+        for (size_t b = lo; b < hi; b++)
+            for (size_t i = b * blockSize; i < min(n, (b + 1) * blockSize); i++)
+                blockBase[b + 1] += canon[i] == i; });
+    for (size_t b = 0; b < blocks; b++)
+        blockBase[b + 1] += blockBase[b];
+    size_t welded = blockBase[blocks];
+    if (welded == n)
+        return n;
+
+    vector<uint32_t> remap(n), kept(welded);
+    pool.parallelFor(0, blocks, 1, [&](size_t lo, size_t hi)
+                     {
+        for (size_t b = lo; b < hi; b++)
+        {
+            size_t next = blockBase[b];
+            for (size_t i = b * blockSize; i < min(n, (b + 1) * blockSize); i++)
+                if (canon[i] == i)
+                {
+                    remap[i] = uint32_t(next);
+                    kept[next++] = uint32_t(i);
+                }
+        } });
+    // 代表总是保留的顶点，上一步已编号，这里只读不写
+    pool.parallelFor(0, n, blockSize, [&](size_t lo, size_t hi)
+                     {
+        for (size_t i = lo; i < hi; i++)
+            if (canon[i] != i)
+                remap[i] = remap[canon[i]]; });
+
+    // 5. 压缩顶点流并改写下标
+    compactStream(verts.pos, kept, pool);
+    compactStream(verts.nor, kept, pool);
+    compactStream(verts.u, kept, pool);
+    compactStream(verts.v, kept, pool);
+    compactStream(verts.r, kept, pool);
+    compactStream(verts.g, kept, pool);
+    compactStream(verts.b, kept, pool);
+    pool.parallelFor(0, indices.size(), blockSize, [&](size_t lo, size_t hi)
+                     {
+        for (size_t i = lo; i < hi; i++)
+            indices[i] = remap[indices[i]]; });
+    return welded;
+}
+
+// ---- 顶点缓存优化 ----
+
+static float lruScore(int pos)
+{
+    if (pos < 0)
+        return 0;
+    // 最近三个顶点就是刚画完的三角形，给固定分，避免反复选同一条边上的三角形
+    if (pos < 3)
+        return 0.75f;
+    return pow(1 - float(pos - 3) / (lruSize - 3), 1.5f);
+}
+
+static float vertexScore(int pos, uint32_t live)
+{
+    // 剩余三角形越少越优先，尽快把顶点用完
+    return live ? lruScore(pos) + 2 / sqrt(float(live)) : 0;
+}
+
+// idx 为 0 起的局部下标，order 写出三角形的新顺序
+static void forsythOrder(const uint32_t *idx, size_t triCount, size_t vertCount, uint32_t *order)
+{
+    // live[v] 为顶点 v 尚未输出的三角形数，这些三角形存在 adj[first[v], first[v] + live[v])
+    vector<uint32_t> live(vertCount, 0), first(vertCount + 1, 0), adj(triCount * 3);
+    for (size_t i = 0; i < triCount * 3; i++)
+        live[idx[i]]++;
+    for (size_t v = 0; v < vertCount; v++)
+        first[v + 1] = first[v] + live[v];
+    {
+        vector<uint32_t> cursor(first.begin(), first.end() - 1);
+        for (size_t i = 0; i < triCount * 3; i++)
+            adj[cursor[idx[i]]++] = uint32_t(i / 3);
+    }
+    vector<int> cachePos(vertCount, -1);
+    vector<float> vScore(vertCount), tScore(triCount);
+    vector<uint8_t> added(triCount, 0);
+    for (size_t v = 0; v < vertCount; v++)
+        vScore[v] = vertexScore(-1, live[v]);
+    auto triScore = [&](size_t t)
+    { return vScore[idx[t * 3]] + vScore[idx[t * 3 + 1]] + vScore[idx[t * 3 + 2]]; };
+    uint32_t best = 0;
+    for (size_t t = 0; t < triCount; t++)
+    {
+        tScore[t] = triScore(t);
+        if (tScore[t] > tScore[best])
+            best = uint32_t(t);
+    }
+
+    uint32_t cache[lruSize + 3];
+    int cacheCount = 0;
+    size_t scan = 0;
+    for (size_t k = 0; k < triCount; k++)
+    {
+        // 缓存里的顶点再没有剩余三角形时，按原顺序取下一个未输出的
+        if (best == none)
+        {
+            while (added[scan])
+                scan++;
+            best = uint32_t(scan);
+        }
+        uint32_t t = best;
+        order[k] = t;
+        added[t] = 1;
+        const uint32_t *tv = idx + t * 3;
+        for (int j = 0; j < 3; j++)
+        {
+            uint32_t v = tv[j], *list = adj.data() + first[v];
+            uint32_t *at = find(list, list + live[v], t);
+            swap(*at, list[--live[v]]);
+        }
+
+        // 三个顶点移到最前，其余依次后移，挤出 lruSize 之外的失效
+        uint32_t next[lruSize + 3];
+        int n = 0;
+        for (int j = 0; j < 3; j++)
+            if (find(next, next + n, tv[j]) == next + n)
+                next[n++] = tv[j];
+        for (int i = 0; i < cacheCount; i++)
+            if (cache[i] != tv[0] && cache[i] != tv[1] && cache[i] != tv[2])
+                next[n++] = cache[i];
+        for (int i = 0; i < n; i++)
+        {
+            cachePos[next[i]] = i < lruSize ? i : -1;
+            vScore[next[i]] = vertexScore(cachePos[next[i]], live[next[i]]);
+            if (i < lruSize)
+                cache[i] = next[i];
+        }
+        cacheCount = min(n, lruSize);
+
+        // 只有分数变了的顶点所在三角形需要重算，下一个三角形也只从它们当中选
+        best = none;
+        float bestScore = -1;
+        for (int i = 0; i < n; i++)
+        {
+            uint32_t v = next[i];
+            for (uint32_t e = first[v]; e < first[v] + live[v]; e++)
+            {
+                uint32_t u = adj[e];
+                tScore[u] = triScore(u);
+                if (tScore[u] > bestScore)
+                    bestScore = tScore[u], best = u;
+            }
+        }
+    }
+}
+
+// ---- 过度绘制优化 ----
+
+// 以时间戳模拟 FIFO：顶点在最近 fifoSize 次未命中内进过缓存即为命中；clock 加 fifoSize + 1 即清空缓存
+struct fifoCache
+{
+    vector<uint32_t> stamp;
+    uint32_t clock = fifoSize + 1;
+
+    explicit fifoCache(size_t vertCount) : stamp(vertCount, 0) {}
+    void reset() { clock += fifoSize + 1; }
+    unsigned misses(const uint32_t *tv)
+    {
+        unsigned m = 0;
+        for (int j = 0; j < 3; j++)
+            if (clock - stamp[tv[j]] > fifoSize)
+            {
+                stamp[tv[j]] = clock++;
+                m++;
+            }
+        return m;
+    }
+};
+
+struct vec3f
+{
+    float x, y, z;
+    vec3f operator+(const vec3f &o) const { return {x + o.x, y + o.y, z + o.z}; }
+    vec3f operator-(const vec3f &o) const { return {x - o.x, y - o.y, z - o.z}; }
+    vec3f operator*(float s) const { return {x * s, y * s, z * s}; }
+    float dot(const vec3f &o) const { return x * o.x + y * o.y + z * o.z; }
+    vec3f cross(const vec3f &o) const { return {y * o.z - z * o.y, z * o.x - x * o.z, x * o.y - y * o.x}; }
+};
+
+// order 为顶点缓存优化后的三角形顺序，原地改成按簇排序后的顺序；pos(v) 取局部顶点 v 的位置
+template <class Pos>
+static void overdrawOrder(const uint32_t *idx, size_t triCount, size_t vertCount, uint32_t *order, Pos pos)
+{
+    fifoCache cache(vertCount);
+    // 硬边界：三个顶点全部未命中的三角形，说明顶点缓存优化在这里跳到了网格的别处
+    vector<size_t> hard;
+    for (size_t k = 0; k < triCount; k++)
+        if (cache.misses(idx + order[k] * 3) == 3 || k == 0)
+            hard.push_back(k);
+    hard.push_back(triCount);
+
+    // 软边界：硬簇内部累计 ACMR 一旦降到硬簇 ACMR 的 clusterSlack 倍以内就切一刀；
+    // 最后剩下的一截通常很差，并回前一个簇
+    vector<size_t> bounds;
+    for (size_t c = 0; c + 1 < hard.size(); c++)
+    {
+        size_t begin = hard[c], end = hard[c + 1];
+        cache.reset();
+        unsigned total = 0;
+        for (size_t k = begin; k < end; k++)
+            total += cache.misses(idx + order[k] * 3);
+        float threshold = clusterSlack * float(total) / float(end - begin);
+        bounds.push_back(begin);
+        cache.reset();
+        unsigned misses = 0, faces = 0;
+        for (size_t k = begin; k < end; k++)
+        {
+            misses += cache.misses(idx + order[k] * 3);
+            if (float(misses) <= threshold * float(++faces))
+            {
+                bounds.push_back(k + 1);
+                cache.reset();
+                misses = faces = 0;
+            }
+        }
+        if (bounds.back() != begin)
+            bounds.pop_back();
+    }
+    bounds.push_back(triCount);
+    size_t clusterCount = bounds.size() - 1;
+    if (clusterCount < 2)
+        return;
+
+    vec3f meshCenter{0, 0, 0};
+    for (size_t i = 0; i < triCount * 3; i++)
+        meshCenter = meshCenter + pos(idx[i]);
+    meshCenter = meshCenter * (1.0f / float(triCount * 3));
+
+    // 簇按面积加权的质心与法线之和算排序键：越朝外（法线背离网格中心）越先画
+    vector<float> key(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        vec3f center{0, 0, 0}, normal{0, 0, 0};
+        float area = 0;
+        for (size_t k = bounds[c]; k < bounds[c + 1]; k++)
+        {
+            const uint32_t *tv = idx + order[k] * 3;
+            vec3f p0 = pos(tv[0]), p1 = pos(tv[1]), p2 = pos(tv[2]);
+            vec3f n = (p1 - p0).cross(p2 - p0);
+            float a = sqrt(n.dot(n));
+            center = center + (p0 + p1 + p2) * (a / 3);
+            normal = normal + n;
+            area += a;
+        }
+        float len = sqrt(normal.dot(normal));
+        key[c] = area > 0 && len > 0 ? (center * (1 / area) - meshCenter).dot(normal * (1 / len)) : 0;
+    }
+    vector<uint32_t> sorted(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+        sorted[c] = uint32_t(c);
+    stable_sort(sorted.begin(), sorted.end(), [&](uint32_t a, uint32_t b)
+                { return key[a] > key[b]; });
+    vector<uint32_t> result;
+    result.reserve(triCount);
+    for (uint32_t c : sorted)
+        result.insert(result.end(), order + bounds[c], order + bounds[c + 1]);
+    copy(result.begin(), result.end(), order);
+}
+
+// 重排 indices[0, count) 中的三角形；localOf 为按顶点数分配、全为 none 的临时数组，返回前恢复，供下一段复用
+static void optimizeRange(const vertexBuffer &verts, uint32_t *indices, size_t count, vector<uint32_t> &localOf)
+{
+    size_t triCount = count / 3;
+    if (triCount < 2)
+        return;
+    vector<uint32_t> local(triCount * 3), global;
+    for (size_t i = 0; i < triCount * 3; i++)
+    {
+        uint32_t &l = localOf[indices[i]];
+        if (l == none)
+        {
+            l = uint32_t(global.size());
+            global.push_back(indices[i]);
+        }
+        local[i] = l;
+    }
+    for (uint32_t v : global)
+        localOf[v] = none;
+
+    vector<uint32_t> order(triCount);
+    forsythOrder(local.data(), triCount, global.size(), order.data());
+    const vec4 *pos = verts.pos.data();
+    overdrawOrder(local.data(), triCount, global.size(), order.data(), [&](uint32_t v)
+                  { const vec4 &p = pos[global[v]]; return vec3f{p.x, p.y, p.z}; });
+
+    for (size_t k = 0; k < triCount; k++)
+        for (int j = 0; j < 3; j++)
+            indices[k * 3 + j] = global[local[order[k] * 3 + j]];
+}
+
+void optimizeMesh(vertexBuffer &verts, alignedVector<uint32_t> &indices, const vector<objMesh> &meshes, ThreadPool &pool)
+{
+    size_t n = verts.size();
+    vector<pair<size_t, size_t>> ranges;
+    for (const objMesh &m : meshes)
+        if (size_t(m.firstIndex) + m.indexCount <= indices.size())
+            ranges.push_back({m.firstIndex, m.indexCount});
+    if (meshes.empty())
+        ranges.push_back({0, indices.size()});
+    // localOf 覆盖整个模型的顶点数，每段都新分配一份的话 R 段就是 O(R·n)；
+    // 改为借用空闲的一份、用完归还，同时在用的份数不超过参与的线程数
+    mutex scratchMtx;
+    vector<vector<uint32_t>> scratch;
+    pool.parallelFor(0, ranges.size(), 1, [&](size_t lo, size_t hi)
+                     {
+        vector<uint32_t> localOf;
+        {
+            lock_guard l(scratchMtx);
+            if (!scratch.empty())
+            {
+                localOf = move(scratch.back());
+                scratch.pop_back();
+            }
+        }
+        if (localOf.size() != n)
+            localOf.assign(n, none);
+        for (size_t r = lo; r < hi; r++)
+            optimizeRange(verts, indices.data() + ranges[r].first, ranges[r].second, localOf);
+        lock_guard l(scratchMtx);
+        scratch.push_back(move(localOf)); });
+
+    // 顶点读取顺序：按第一次被引用的先后重新编号
+    vector<uint32_t> remap(n, none), kept;
+    kept.reserve(n);
+    for (uint32_t &i : indices)
+    {
+        if (remap[i] == none)
+        {
+            remap[i] = uint32_t(kept.size());
+            kept.push_back(i);
+        }
+        i = remap[i];
+    }
+    for (size_t v = 0; v < n; v++)
+        if (remap[v] == none)
+            kept.push_back(uint32_t(v));
+    compactStream(verts.pos, kept, pool);
+    compactStream(verts.nor, kept, pool);
+    compactStream(verts.u, kept, pool);
+    compactStream(verts.v, kept, pool);
+    compactStream(verts.r, kept, pool);
+    compactStream(verts.g, kept, pool);
+    compactStream(verts.b, kept, pool);
+}
+
+// ---- 统计 ----
+
+// 沿 axis 轴正交投影（sign 为 -1 时从正方向看），返回 {通过深度测试的片元数, 覆盖的像素数}
+static pair<uint64_t, uint64_t> rasterOverdraw(const vector<vec3f> &grid, int axis, float sign)
+{
+    int ax = (axis + 1) % 3, ay = (axis + 2) % 3;
+    vector<float> depth(overdrawGrid * overdrawGrid, numeric_limits<float>::infinity());
+    uint64_t shaded = 0;
+    for (size_t t = 0; t + 2 < grid.size(); t += 3)
+    {
+        float x[3], y[3], z[3];
+        for (int j = 0; j < 3; j++)
+        {
+            const float *p = &grid[t + j].x;
+            x[j] = p[ax], y[j] = p[ay], z[j] = sign * p[axis];
+        }
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+        // 逆时针为正面，与光栅器的默认背面剔除一致
+        if (sign * area >= 0)
+            continue;
+        if (area < 0)
+        {
+            swap(x[1], x[2]), swap(y[1], y[2]), swap(z[1], z[2]);
+            area = -area;
+        }
+        int x0 = max(0, int(floor(min({x[0], x[1], x[2]})))), x1 = min(overdrawGrid - 1, int(ceil(max({x[0], x[1], x[2]}))));
+        int y0 = max(0, int(floor(min({y[0], y[1], y[2]})))), y1 = min(overdrawGrid - 1, int(ceil(max({y[0], y[1], y[2]}))));
+        for (int py = y0; py <= y1; py++)
+            for (int px = x0; px <= x1; px++)
+            {
+                float cx = px + 0.5f, cy = py + 0.5f;
+                float w0 = (x[2] - x[1]) * (cy - y[1]) - (y[2] - y[1]) * (cx - x[1]);
+                float w1 = (x[0] - x[2]) * (cy - y[2]) - (y[0] - y[2]) * (cx - x[2]);
+                float w2 = (x[1] - x[0]) * (cy - y[0]) - (y[1] - y[0]) * (cx - x[0]);
+                if (w0 < 0 || w1 < 0 || w2 < 0)
+                    continue;
+                float d = (w0 * z[0] + w1 * z[1] + w2 * z[2]) / area;
+                float &dst = depth[py * overdrawGrid + px];
+                if (d < dst)
+                {
+                    dst = d;
+                    shaded++;
+                }
+            }
+    }
+    uint64_t covered = count_if(depth.begin(), depth.end(), [](float d)
+                                { return d != numeric_limits<float>::infinity(); });
+    return {shaded, covered};
+}
+
+meshStats analyzeMesh(const vertexBuffer &verts, const indexBuffer &indices, ThreadPool &pool)
+{
+    meshStats res{0, 0, 0};
+    size_t triCount = indices.size() / 3;
+    if (!triCount)
+        return res;
+
+    fifoCache cache(verts.size());
+    vector<uint8_t> used(verts.size(), 0);
+    uint64_t misses = 0, usedCount = 0;
+    for (size_t t = 0; t < triCount; t++)
+    {
+        uint32_t tv[3];
+        indices.triangle(t, tv);
+        misses += cache.misses(tv);
+        for (uint32_t v : tv)
+            if (!used[v])
+                used[v] = 1, usedCount++;
+    }
+    res.acmr = double(misses) / double(triCount);
+    res.atvr = double(misses) / double(usedCount);
+
+    // 包围盒等比缩放进网格，留出半个像素
+    const vec4 *pos = verts.pos.data();
+    float boxLo[3], boxHi[3];
+    for (int k = 0; k < 3; k++)
+        boxLo[k] = numeric_limits<float>::max(), boxHi[k] = -numeric_limits<float>::max();
+    for (size_t i = 0; i < triCount * 3; i++)
+    {
+        const float *p = &pos[indices[i]].x;
+        for (int k = 0; k < 3; k++)
+            boxLo[k] = min(boxLo[k], p[k]), boxHi[k] = max(boxHi[k], p[k]);
+    }
+    float extent = max({boxHi[0] - boxLo[0], boxHi[1] - boxLo[1], boxHi[2] - boxLo[2]});
+    float scale = extent > 0 ? (overdrawGrid - 1) / extent : 0;
+    vector<vec3f> grid(triCount * 3);
+    for (size_t i = 0; i < triCount * 3; i++)
+    {
+        const vec4 &p = pos[indices[i]];
+        grid[i] = {(p.x - boxLo[0]) * scale + 0.5f, (p.y - boxLo[1]) * scale + 0.5f, (p.z - boxLo[2]) * scale + 0.5f};
+    }
+    pair<uint64_t, uint64_t> views[6];
+    pool.parallelFor(0, 6, 1, [&](size_t lo, size_t hi)
+                     {
+        for (size_t i = lo; i < hi; i++)
+            views[i] = rasterOverdraw(grid, int(i / 2), i % 2 ? -1.0f : 1.0f); });
+    uint64_t shaded = 0, covered = 0;
+    for (auto &v : views)
+        shaded += v.first, covered += v.second;
+    res.overdraw = covered ? double(shaded) / double(covered) : 0;
+    return res;
+}
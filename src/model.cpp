@@ -1,25 +1,150 @@
 #include "model.h"
+#include "objLoader.h"
+#include "meshCache.h"
+#include "meshTools.h"
+#include "cpuFeature.h"
 #include <math.h>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MODEL_X86_SIMD
+#endif
 using namespace std;
 
-vec3 model::getTexColor(double u, double v) const
+vec3 model::getTexColor(real u, real v) const
 {
     // u = max(u, 0.);
     // u = min(u, 1.);
 
     // v = max(v, 0.);
     // v = min(v, 1.);
-    int uTex = int(u * texWidth);
-    int vTex = int((1 - v) * texHeight);
+    int uTex = clamp(int(u * texWidth), 0, texWidth - 1);
+    int vTex = clamp(int((1 - v) * texHeight), 0, texHeight - 1);
     vec3 res;
     for (int i = 0; i < 3; i++)
-        res[i] = *((pTextureData + (vTex * texWidth + uTex) * 3) + i);
+        res[i] = *((pTextureData + (vTex * texWidth + uTex) * 4) + i);
     return res;
 }
 
+#ifdef MODEL_X86_SIMD
+__attribute__((target("avx2,fma"))) static void texFetchAvx2(const unsigned char *tex, int w, int h, fragmentBatch &b, int i)
+{
+    __m256 u = _mm256_load_ps(b.u + i), v = _mm256_load_ps(b.v + i);
+    __m256i x = _mm256_cvttps_epi32(_mm256_mul_ps(u, _mm256_set1_ps(float(w))));
+    __m256i y = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1), v), _mm256_set1_ps(float(h))));
+    x = _mm256_min_epi32(_mm256_max_epi32(x, _mm256_setzero_si256()), _mm256_set1_epi32(w - 1));
+    y = _mm256_min_epi32(_mm256_max_epi32(y, _mm256_setzero_si256()), _mm256_set1_epi32(h - 1));
+    __m256i texel = _mm256_i32gather_epi32((const int *)tex, _mm256_add_epi32(_mm256_mullo_epi32(y, _mm256_set1_epi32(w)), x), 4);
+    __m256i byteMask = _mm256_set1_epi32(0xff);
+    for (int c = 0; c < 3; c++)
+        _mm256_store_ps(b.color[c] + i, _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texel, c * 8), byteMask)));
+}
+
+__attribute__((target("avx512f,avx512dq,fma"))) static void texFetchAvx512(const unsigned char *tex, int w, int h, fragmentBatch &b, int i)
+{
+    __m512 u = _mm512_load_ps(b.u + i), v = _mm512_load_ps(b.v + i);
+    __m512i x = _mm512_cvttps_epi32(_mm512_mul_ps(u, _mm512_set1_ps(float(w))));
+    __m512i y = _mm512_cvttps_epi32(_mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(1), v), _mm512_set1_ps(float(h))));
+    x = _mm512_min_epi32(_mm512_max_epi32(x, _mm512_setzero_si512()), _mm512_set1_epi32(w - 1));
+    y = _mm512_min_epi32(_mm512_max_epi32(y, _mm512_setzero_si512()), _mm512_set1_epi32(h - 1));
+    __m512i texel = _mm512_i32gather_epi32(_mm512_add_epi32(_mm512_mullo_epi32(y, _mm512_set1_epi32(w)), x), tex, 4);
+    __m512i byteMask = _mm512_set1_epi32(0xff);
+    for (int c = 0; c < 3; c++)
+        _mm512_store_ps(b.color[c] + i, _mm512_cvtepi32_ps(_mm512_and_si512(_mm512_srli_epi32(texel, c * 8), byteMask)));
+}
+#endif
+
+// 批量纹理采样，结果写入 batch.color；SSE4 没有 gather，与标量共用逐个读取
+void model::getTexColor(fragmentBatch &batch) const
+{
+    int i = 0;
+#ifdef MODEL_X86_SIMD
+    simdLevel level = cpuFeature::level();
+    if (level == simdLevel::avx512)
+        for (; i + 16 <= batch.count; i += 16)
+            texFetchAvx512(pTextureData, texWidth, texHeight, batch, i);
+    if (level >= simdLevel::avx2)
+        for (; i + 8 <= batch.count; i += 8)
+            texFetchAvx2(pTextureData, texWidth, texHeight, batch, i);
+#endif
+    for (; i < batch.count; i++)
+    {
+        vec3 c = getTexColor(batch.u[i], batch.v[i]);
+        for (int k = 0; k < 3; k++)
+            batch.color[k][i] = float(c[k]);
+    }
+}
+
+uint32_t model::addVertex(vec3 pos, optional<vec3> nor, double u, double v, vec3 color)
+{
+    vec3 n = nor.value_or(vec3(0, 0, 0));
+    verts.pos.push_back({float(pos[0]), float(pos[1]), float(pos[2]), 1});
+    verts.nor.push_back({float(n[0]), float(n[1]), float(n[2]), 0});
+    verts.u.push_back(float(u));
+    verts.v.push_back(float(v));
+    verts.r.push_back(uint8_t(clamp(int(color[0]), 0, 255)));
+    verts.g.push_back(uint8_t(clamp(int(color[1]), 0, 255)));
+    verts.b.push_back(uint8_t(clamp(int(color[2]), 0, 255)));
+    return uint32_t(verts.size() - 1);
+}
+
+void model::addTriangle(uint32_t a, uint32_t b, uint32_t c)
+{
+    auto &idx = indices.edit32();
+    idx.insert(idx.end(), {a, b, c});
+}
+
 void model::addTriangle(const Triangle &t)
 {
-    tris.push_back(t);
+    uint32_t idx[3];
+    for (int i = 0; i < 3; i++)
+    {
+        const Point &p = t.getVertex(i);
+        idx[i] = addVertex(vec3(p.data[0] / p.data[3], p.data[1] / p.data[3], p.data[2] / p.data[3]), t.normal[i], t.uTex[i], t.vTex[i],
+                           vec3(t.colorR[i], t.colorG[i], t.colorB[i]));
+    }
+    addTriangle(idx[0], idx[1], idx[2]);
+}
+
+Triangle model::getTriangle(int idx) const
+{
+    Triangle res;
+    for (int i = 0; i < 3; i++)
+    {
+        uint32_t k = indices[idx * 3 + i];
+        const vec4 &p = verts.pos[k], &n = verts.nor[k];
+        res.setVertex(vec3(p.x, p.y, p.z), i);
+        if (n.x != 0 || n.y != 0 || n.z != 0)
+            res.setNormal(vec3(n.x, n.y, n.z), i);
+        res.setTexCoord(verts.u[k], verts.v[k], i);
+        res.setColor(verts.r[k], verts.g[k], verts.b[k], i);
+    }
+    return res;
+}
+
+void model::setColor(int r, int g, int b)
+{
+    verts.r.edit().assign(verts.size(), uint8_t(clamp(r, 0, 255)));
+    verts.g.edit().assign(verts.size(), uint8_t(clamp(g, 0, 255)));
+    verts.b.edit().assign(verts.size(), uint8_t(clamp(b, 0, 255)));
+}
+
+size_t model::weld(ThreadPool &pool)
+{
+    weldVertices(verts, indices.edit32(), pool);
+    indices.compact(verts.size());
+    return verts.size();
+}
+
+void model::optimize(ThreadPool &pool)
+{
+    optimizeMesh(verts, indices.edit32(), meshes, pool);
+    indices.compact(verts.size());
+}
+
+meshStats model::analyze(ThreadPool &pool) const
+{
+    return analyzeMesh(verts, indices, pool);
 }
 
 void model::addLine(const Point &start, const Point &end)
@@ -27,19 +152,16 @@ void model::addLine(const Point &start, const Point &end)
     lines.push_back({start, end});
 }
 
-model model::translate(vec3 v)
+Matrix model::translation(vec3 v)
 {
-    model res = *this;
     Matrix t = Matrix::identity();
     for (int i = 0; i < 3; i++)
         t.setData(i, 3, v[i]);
-    res.modelMatrix *= t;
-    return res;
+    return t;
 }
 
-model model::rotate(double deg, vec3 r)
+Matrix model::rotation(double deg, vec3 r)
 {
-    model res = *this;
     deg = deg * acos(-1) / 180;
     Matrix rot = Matrix::identity();
     rot *= cos(deg);
@@ -53,17 +175,35 @@ model model::rotate(double deg, vec3 r)
         {-r[1], r[0], 0}};
     rot += n.trans() * n * (1 - cos(deg)) + N * sin(deg);
     rot.setData(3, 3, 1);
-    res.modelMatrix *= rot;
-    return res;
+    return rot;
 }
 
-model model::scale(vec3 v)
+Matrix model::scaling(vec3 v)
 {
-    model res = *this;
     Matrix t = Matrix::identity();
     for (int i = 0; i < 3; i++)
         t.setData(i, i, v[i]);
-    res.modelMatrix *= t;
+    return t;
+}
+
+model model::translate(vec3 v)
+{
+    model res = *this;
+    res.modelMatrix *= translation(v);
+    return res;
+}
+
+model model::rotate(double deg, vec3 r)
+{
+    model res = *this;
+    res.modelMatrix *= rotation(deg, r);
+    return res;
+}
+
+model model::scale(vec3 v)
+{
+    model res = *this;
+    res.modelMatrix *= scaling(v);
     return res;
 }
 
@@ -87,20 +227,16 @@ model model::cube(bool frame)
             }
     }
 
-    res.addTriangle(Triangle{p[1], p[2], p[0]});
-    res.addTriangle(Triangle{p[3], p[2], p[1]});
-    res.addTriangle(Triangle{p[4], p[6], p[5]});
-    res.addTriangle(Triangle{p[5], p[6], p[7]});
-
-    res.addTriangle(Triangle{p[0], p[4], p[1]});
-    res.addTriangle(Triangle{p[1], p[4], p[5]});
-    res.addTriangle(Triangle{p[3], p[6], p[2]});
-    res.addTriangle(Triangle{p[7], p[6], p[3]});
-
-    res.addTriangle(Triangle{p[2], p[4], p[0]});
-    res.addTriangle(Triangle{p[6], p[4], p[2]});
-    res.addTriangle(Triangle{p[1], p[5], p[3]});
-    res.addTriangle(Triangle{p[3], p[5], p[7]});
+    // 立方体没有顶点法线，按面法线着色，8 个顶点可直接共享
+    uint32_t v[8];
+    for (int i = 0; i < 8; i++)
+        v[i] = res.addVertex(vec3(p[i][0], p[i][1], p[i][2]));
+    const int faces[12][3] = {
+        {1, 2, 0}, {3, 2, 1}, {4, 6, 5}, {5, 6, 7},
+        {0, 4, 1}, {1, 4, 5}, {3, 6, 2}, {7, 6, 3},
+        {2, 4, 0}, {6, 4, 2}, {1, 5, 3}, {3, 5, 7}};
+    for (auto &f : faces)
+        res.addTriangle(v[f[0]], v[f[1]], v[f[2]]);
 
     return res;
 }
@@ -118,22 +254,82 @@ model model::plain(bool frame)
         res.addLine(p[1], p[3]);
         res.addLine(p[2], p[3]);
     }
-    Triangle t1 = {p[1], p[2], p[0]};
-    t1.setTexCoord(1, 0, 0);
-    t1.setTexCoord(0, 1, 1);
-    t1.setTexCoord(0, 0, 2);
-
-    Triangle t2 = {p[3], p[2], p[1]};
-    t2.setTexCoord(1, 1, 0);
-    t2.setTexCoord(0, 1, 1);
-    t2.setTexCoord(1, 0, 2);
-
-    res.addTriangle(t1);
-    res.addTriangle(t2);
+    // 纹理坐标与顶点位置一一对应，两个三角形共享对角线上的顶点
+    uint32_t v[4];
+    for (int i = 0; i < 4; i++)
+        v[i] = res.addVertex(vec3(p[i][0], p[i][1], p[i][2]), {}, i % 2, i / 2);
+    res.addTriangle(v[1], v[2], v[0]);
+    res.addTriangle(v[3], v[2], v[1]);
     return res;
 }
 
 void model::loadTexture(const char *name)
 {
-    pTextureData = stbi_load(name, &texHeight, &texWidth, nullptr, 3);
+    pTextureData = stbi_load(name, &texWidth, &texHeight, nullptr, 4);
+}
+
+bool model::loadObj(const char *name, bool useCache, ThreadPool &pool, meshAnalysis *analysis)
+{
+    vertexBuffer vb;
+    indexBuffer idx;
+    vector<objMesh> ms;
+    string lib;
+    meshBounds b;
+    // 命中缓存时拿不到焊接前的网格，要统计就重新解析
+    if (!useCache || analysis || !meshCache::load(name, vb, idx, ms, lib, b, pool))
+    {
+        objLoader loader;
+        if (!loader.load(name, pool))
+            return false;
+        vb = move(loader.verts);
+        idx.i32 = move(loader.indices);
+        if (analysis)
+            analysis->before = analyzeMesh(vb, idx, pool);
+        // OBJ 里重复的 v / vt / vn 行会生成值相同的顶点，焊接并重排后再写缓存，命中缓存时不必再做
+        weldVertices(vb, idx.i32.edit(), pool);
+        optimizeMesh(vb, idx.i32.edit(), loader.meshes, pool);
+        idx.compact(vb.size());
+        if (analysis)
+            analysis->after = analyzeMesh(vb, idx, pool);
+        // 写缓存失败（如目录只读）不影响本次载入
+        if (useCache)
+            meshCache::save(name, vb, idx, loader.meshes, loader.materialLib);
+        ms = move(loader.meshes);
+        lib = move(loader.materialLib);
+        b = computeBounds(vb.pos.data(), nullptr, vb.size());
+    }
+    if (materialLib.empty())
+        materialLib = move(lib);
+    if (!verts.size())
+    {
+        verts = move(vb);
+        indices = move(idx);
+        meshes = move(ms);
+        bounds = b;
+        return true;
+    }
+    // 追加到已有的顶点与下标之后，各段区间随之平移
+    uint32_t base = vertexCount(), firstIndex = uint32_t(indices.size());
+    for (objMesh &m : ms)
+    {
+        m.firstIndex += firstIndex;
+        meshes.push_back(move(m));
+    }
+    auto append = [](auto &dst, const auto &src)
+    {
+        auto &d = dst.edit();
+        d.insert(d.end(), src.begin(), src.end());
+    };
+    append(verts.pos, vb.pos);
+    append(verts.nor, vb.nor);
+    append(verts.u, vb.u);
+    append(verts.v, vb.v);
+    append(verts.r, vb.r);
+    append(verts.g, vb.g);
+    append(verts.b, vb.b);
+    auto &dst = indices.edit32();
+    for (size_t i = 0; i < idx.size(); i++)
+        dst.push_back(base + idx[i]);
+    bounds = computeBounds(verts.pos.data(), nullptr, verts.size());
+    return true;
 }
@@ -0,0 +1,442 @@
+#include "objLoader.h"
+#include "mappedFile.h"
+#include <charconv>
+#include <cstring>
+#include <utility>
+#include <cmath>
+using namespace std;
+
+static constexpr int32_t missing = -1, invalid = -2;
+static constexpr uint32_t none = UINT32_MAX;
+static constexpr size_t chunkBytes = 1 << 20;   // 每块约 1 MB，小文件只有一块
+static constexpr size_t minPartition = 1 << 12; // 去重分区至少覆盖的位置数
+static constexpr size_t maxPartitions = 256;
+
+meshBounds computeBounds(const vec4 *pos, const uint32_t *idx, size_t count)
+{
+    meshBounds res{{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, 0};
+    if (!count)
+        return res;
+    auto at = [&](size_t i) -> const vec4 &
+    { return pos[idx ? idx[i] : i]; };
+    for (int k = 0; k < 3; k++)
+        res.lo[k] = res.hi[k] = (&at(0).x)[k];
+    for (size_t i = 1; i < count; i++)
+        for (int k = 0; k < 3; k++)
+        {
+            res.lo[k] = min(res.lo[k], (&at(i).x)[k]);
+            res.hi[k] = max(res.hi[k], (&at(i).x)[k]);
+        }
+    for (int k = 0; k < 3; k++)
+        res.center[k] = (res.lo[k] + res.hi[k]) / 2;
+    float r2 = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const vec4 &p = at(i);
+        float dx = p.x - res.center[0], dy = p.y - res.center[1], dz = p.z - res.center[2];
+        r2 = max(r2, dx * dx + dy * dy + dz * dz);
+    }
+    res.radius = sqrt(r2);
+    return res;
+}
+
+static bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static string_view trim(string_view s)
+{
+    while (!s.empty() && isBlank(s.front()))
+        s.remove_prefix(1);
+    while (!s.empty() && isBlank(s.back()))
+        s.remove_suffix(1);
+    return s;
+}
+
+// 取下一个以空白分隔的词，s 前进到词之后
+static string_view nextToken(string_view &s)
+{
+    size_t b = 0;
+    while (b < s.size() && isBlank(s[b]))
+        b++;
+    size_t e = b;
+    while (e < s.size() && !isBlank(s[e]))
+        e++;
+    string_view tok = s.substr(b, e - b);
+    s.remove_prefix(e);
+    return tok;
+}
+
+// 解析若干个浮点数，缺省的分量保持 res 中原值；from_chars 不接受前导 '+'
+static void parseFloats(string_view s, float *res, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        string_view tok = nextToken(s);
+        if (tok.empty())
+            return;
+        if (tok.front() == '+')
+            tok.remove_prefix(1);
+        from_chars(tok.data(), tok.data() + tok.size(), res[i]);
+    }
+}
+
+// OBJ 下标从 1 开始；负数表示当前已定义的倒数第几个，此时返回相对本块起点的偏移并置 relative
+static int32_t rawIndex(string_view tok, size_t localCount, bool &relative)
+{
+    relative = false;
+    if (tok.empty())
+        return missing;
+    long long i = 0;
+    if (from_chars(tok.data(), tok.data() + tok.size(), i).ec != errc() || i == 0)
+        return invalid;
+    if (i > 0)
+        return i <= INT32_MAX ? int32_t(i - 1) : invalid;
+    relative = true;
+    i += (long long)localCount;
+    return i >= INT32_MIN ? int32_t(i) : invalid;
+}
+
+// 换算成绝对下标，越界记为非法
+static int32_t resolveIndex(int32_t raw, bool relative, size_t base, size_t total)
+{
+    if (!relative)
+        return raw < 0 || size_t(raw) < total ? raw : invalid;
+    long long i = (long long)base + raw;
+    return i >= 0 && i < (long long)total ? int32_t(i) : invalid;
+}
+
+// 面顶点写作 v、v/vt、v//vn 或 v/vt/vn；不足三个顶点的面丢弃
+void objLoader::parseFace(chunk &c, string_view rest)
+{
+    size_t first = c.corners.size();
+    const size_t counts[3] = {c.positions.size(), c.texCoords.size(), c.normals.size()};
+    for (string_view tok = nextToken(rest); !tok.empty(); tok = nextToken(rest))
+    {
+        rawCorner r{{missing, missing, missing}, 0};
+        string_view part[3] = {tok, {}, {}};
+        size_t s1 = tok.find('/');
+        if (s1 != string_view::npos)
+        {
+            part[0] = tok.substr(0, s1);
+            string_view t = tok.substr(s1 + 1);
+            size_t s2 = t.find('/');
+            part[1] = t.substr(0, s2);
+            if (s2 != string_view::npos)
+                part[2] = t.substr(s2 + 1);
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            bool rel;
+            r.idx[k] = rawIndex(part[k], counts[k], rel);
+            r.relative |= rel << k;
+        }
+        c.corners.push_back(r);
+    }
+    size_t n = c.corners.size() - first;
+    if (n < 3)
+        c.corners.resize(first);
+    else
+        c.faceSize.push_back(uint32_t(n));
+}
+
+void objLoader::parseLine(chunk &c, string_view line)
+{
+    string_view rest = line;
+    string_view key = nextToken(rest);
+    if (key.empty() || key.front() == '#')
+        return;
+    if (key == "v")
+    {
+        vec4 p{0, 0, 0, 1};
+        parseFloats(rest, &p.x, 3);
+        c.positions.push_back(p);
+    }
+    else if (key == "vt")
+    {
+        texCoord t{0, 0};
+        parseFloats(rest, &t.u, 2);
+        c.texCoords.push_back(t);
+    }
+    else if (key == "vn")
+    {
+        vec4 n{0, 0, 0, 0};
+        parseFloats(rest, &n.x, 3);
+        c.normals.push_back(n);
+    }
+    else if (key == "f")
+        parseFace(c, rest);
+    else if (key == "o" || key == "g" || key == "usemtl")
+        c.groups.push_back({uint32_t(c.faceSize.size()), key == "usemtl", trim(rest), 0});
+    else if (key == "mtllib")
+        c.materialLib = trim(rest);
+}
+
+void objLoader::parseChunk(chunk &c)
+{
+    const char *p = c.text.data(), *end = p + c.text.size();
+    while (p < end)
+    {
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        if (!eol)
+            eol = end;
+        parseLine(c, string_view(p, eol - p));
+        p = eol + 1;
+    }
+}
+
+// 拷贝本块的 v / vt / vn 到全局数组，面顶点换算成绝对下标；含非法下标的面整面作废（位置记为非法）
+void objLoader::resolveChunk(chunk &c, size_t partSize, size_t parts)
+{
+    copy(c.positions.begin(), c.positions.end(), positions.begin() + c.posBase);
+    copy(c.texCoords.begin(), c.texCoords.end(), texCoords.begin() + c.texBase);
+    copy(c.normals.begin(), c.normals.end(), normals.begin() + c.norBase);
+    const size_t base[3] = {c.posBase, c.texBase, c.norBase}, total[3] = {positions.size(), texCoords.size(), normals.size()};
+
+    c.partCursor.assign(parts, 0);
+    c.cornerCount = c.corners.size();
+    c.triCount = 0;
+    rawCorner *out = corners.data() + c.cornerBase;
+    const rawCorner *in = c.corners.data();
+    for (uint32_t n : c.faceSize)
+    {
+        bool valid = true;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            for (int k = 0; k < 3; k++)
+                out[i].idx[k] = resolveIndex(in[i].idx[k], in[i].relative >> k & 1, base[k], total[k]);
+            out[i].relative = 0;
+            valid &= out[i].idx[0] >= 0 && out[i].idx[1] != invalid && out[i].idx[2] != invalid;
+        }
+        if (valid)
+        {
+            for (uint32_t i = 0; i < n; i++)
+                c.partCursor[out[i].idx[0] / partSize]++;
+            c.triCount += n - 2;
+        }
+        else
+            for (uint32_t i = 0; i < n; i++)
+                out[i].idx[0] = invalid;
+        in += n;
+        out += n;
+    }
+    c.positions = {};
+    c.texCoords = {};
+    c.normals = {};
+    c.corners = {};
+}
+
+// 一个位置分区内按原顺序去重：同一位置下标上 vt / vn 都相同的面顶点共享第一次出现的那个
+void objLoader::dedupPartition(size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        uint32_t id = order[i];
+        const rawCorner &r = corners[id];
+        uint32_t k = bucket[r.idx[0]];
+        while (k != none && (corners[k].idx[1] != r.idx[1] || corners[k].idx[2] != r.idx[2]))
+            k = link[k];
+        if (k == none)
+        {
+            link[id] = bucket[r.idx[0]];
+            bucket[r.idx[0]] = id;
+            k = id;
+        }
+        canon[id] = k;
+    }
+}
+
+// 代表面顶点按首次出现的顺序编号并写出顶点；编号存回 link（去重结束后链表已无用）
+void objLoader::emitVertices(chunk &c)
+{
+    vec4 *pos = verts.pos.edit().data(), *nor = verts.nor.edit().data();
+    float *u = verts.u.edit().data(), *v = verts.v.edit().data();
+    uint32_t id = uint32_t(c.vertBase);
+    for (size_t g = c.cornerBase; g < c.cornerBase + c.cornerCount; g++)
+    {
+        const rawCorner &r = corners[g];
+        if (r.idx[0] < 0 || canon[g] != g)
+            continue;
+        link[g] = id;
+        pos[id] = positions[r.idx[0]];
+        nor[id] = r.idx[2] == missing ? vec4{0, 0, 0, 0} : normals[r.idx[2]];
+        u[id] = r.idx[1] == missing ? 0 : texCoords[r.idx[1]].u;
+        v[id] = r.idx[1] == missing ? 0 : texCoords[r.idx[1]].v;
+        id++;
+    }
+}
+
+// 多边形按扇形 (0, i, i + 1) 拆成三角形，同时记下各分段事件发生时的输出位置
+void objLoader::emitIndices(chunk &c)
+{
+    uint32_t *out = indices.data() + c.triBase * 3;
+    size_t g = c.cornerBase, e = 0;
+    for (uint32_t f = 0; f < c.faceSize.size(); f++)
+    {
+        for (; e < c.groups.size() && c.groups[e].face == f; e++)
+            c.groups[e].offset = uint32_t(out - indices.data());
+        uint32_t n = c.faceSize[f];
+        if (corners[g].idx[0] >= 0)
+            for (uint32_t i = 1; i + 1 < n; i++)
+            {
+                *out++ = link[canon[g]];
+                *out++ = link[canon[g + i]];
+                *out++ = link[canon[g + i + 1]];
+            }
+        g += n;
+    }
+    for (; e < c.groups.size(); e++)
+        c.groups[e].offset = uint32_t(out - indices.data());
+}
+
+// 按文件顺序重放 o / g / usemtl：o / g 换名字沿用材质，usemtl 换材质沿用名字；只保留有三角形的段
+void objLoader::buildMeshes(vector<chunk> &chunks)
+{
+    meshes.push_back({});
+    for (chunk &c : chunks)
+    {
+        if (!c.materialLib.empty())
+            materialLib = c.materialLib;
+        for (const groupEvent &e : c.groups)
+        {
+            objMesh &cur = meshes.back();
+            cur.indexCount = e.offset - cur.firstIndex;
+            objMesh next = cur;
+            (e.material ? next.material : next.name) = e.name;
+            next.firstIndex = e.offset;
+            next.indexCount = 0;
+            if (cur.indexCount)
+                meshes.push_back(move(next));
+            else
+                cur = move(next);
+        }
+    }
+    meshes.back().indexCount = uint32_t(indices.size() - meshes.back().firstIndex);
+    erase_if(meshes, [](const objMesh &m)
+             { return m.indexCount == 0; });
+}
+
+bool objLoader::load(const char *path, ThreadPool &pool)
+{
+    mappedFile file;
+    if (!file.open(path))
+        return false;
+    verts = {};
+    indices.clear();
+    meshes.clear();
+    materialLib.clear();
+
+    // 1. 按行对齐切块，各块独立解析，负下标先记成块内相对偏移
+    string_view text = file.view();
+    size_t nChunks = max<size_t>(1, text.size() / chunkBytes);
+    vector<chunk> chunks(nChunks);
+    for (size_t i = 0, begin = 0; i < nChunks; i++)
+    {
+        size_t end = text.size();
+        if (i + 1 < nChunks)
+        {
+            end = text.find('\n', max(begin, text.size() * (i + 1) / nChunks));
+            end = end == string_view::npos ? text.size() : end + 1;
+        }
+        chunks[i].text = text.substr(begin, end - begin);
+        begin = end;
+    }
+    auto eachChunk = [&](auto &&fn)
+    {
+        pool.parallelFor(0, nChunks, 1, [&](size_t lo, size_t hi)
+                         {
+            for (size_t i = lo; i < hi; i++)
+                fn(chunks[i]); });
+    };
+    eachChunk([](chunk &c)
+              { parseChunk(c); });
+
+    // 2. 前缀和得到各块的起点，并行换算下标、拼接 v / vt / vn
+    size_t nPos = 0, nTex = 0, nNor = 0, nCorner = 0;
+    for (chunk &c : chunks)
+    {
+        c.posBase = nPos;
+        c.texBase = nTex;
+        c.norBase = nNor;
+        c.cornerBase = nCorner;
+        nPos += c.positions.size();
+        nTex += c.texCoords.size();
+        nNor += c.normals.size();
+        nCorner += c.corners.size();
+    }
+    if (nPos > INT32_MAX || nTex > INT32_MAX || nNor > INT32_MAX || nCorner >= none)
+        return false;
+    positions.resize(nPos);
+    texCoords.resize(nTex);
+    normals.resize(nNor);
+    corners.resize(nCorner);
+    size_t partSize = max(minPartition, (nPos + maxPartitions - 1) / maxPartitions);
+    size_t parts = (nPos + partSize - 1) / partSize;
+    eachChunk([&](chunk &c)
+              { resolveChunk(c, partSize, parts); });
+
+    // 3. 按位置下标分区（计数排序，分区内保持文件顺序），各分区并行去重；同一位置的面顶点只会落在同一分区
+    vector<size_t> partBegin(parts + 1, 0);
+    for (size_t p = 0, off = 0; p < parts; p++)
+    {
+        partBegin[p] = off;
+        for (chunk &c : chunks)
+            off += exchange(c.partCursor[p], off);
+        partBegin[p + 1] = off;
+    }
+    order.resize(parts ? partBegin[parts] : 0);
+    eachChunk([&](chunk &c)
+              {
+        for (size_t g = c.cornerBase; g < c.cornerBase + c.cornerCount; g++)
+            if (corners[g].idx[0] >= 0)
+                order[c.partCursor[corners[g].idx[0] / partSize]++] = uint32_t(g); });
+    bucket.assign(nPos, none);
+    link.resize(nCorner);
+    canon.resize(nCorner);
+    pool.parallelFor(0, parts, 1, [&](size_t lo, size_t hi)
+                     { dedupPartition(partBegin[lo], partBegin[hi]); });
+
+    // 4. 代表面顶点按文件顺序编号：先数各块的代表数，前缀和后各块并行写出顶点与下标
+    eachChunk([&](chunk &c)
+              {
+        c.vertCount = 0;
+        for (size_t g = c.cornerBase; g < c.cornerBase + c.cornerCount; g++)
+            c.vertCount += corners[g].idx[0] >= 0 && canon[g] == g; });
+    size_t nVert = 0, nTri = 0;
+    for (chunk &c : chunks)
+    {
+        c.vertBase = nVert;
+        nVert += c.vertCount;
+        c.triBase = nTri;
+        nTri += c.triCount;
+    }
+    verts.pos.edit().resize(nVert);
+    verts.nor.edit().resize(nVert);
+    verts.u.edit().resize(nVert);
+    verts.v.edit().resize(nVert);
+    verts.r.edit().assign(nVert, 255);
+    verts.g.edit().assign(nVert, 255);
+    verts.b.edit().assign(nVert, 255);
+    indices.resize(nTri * 3);
+    eachChunk([&](chunk &c)
+              { emitVertices(c); });
+    eachChunk([&](chunk &c)
+              { emitIndices(c); });
+    buildMeshes(chunks);
+    pool.parallelFor(0, meshes.size(), 1, [&](size_t lo, size_t hi)
+                     {
+        for (size_t i = lo; i < hi; i++)
+            meshes[i].bounds = computeBounds(verts.pos.data(), indices.data() + meshes[i].firstIndex, meshes[i].indexCount); });
+
+    // 中间数组随即释放
+    positions = {};
+    normals = {};
+    texCoords = {};
+    corners = {};
+    order = {};
+    bucket = {};
+    link = {};
+    canon = {};
+    return true;
+}
@@ -3,21 +3,26 @@
 #include <algorithm>
 using namespace std;
 
-void rasterizer::clearBuffer()
+void rasterizer::clearBuffer(frameContext &f)
 {
     int sz = width * height;
-    zBuffer.resize(sz);
-    fill_n(zBuffer.begin(), sz, numeric_limits<float>::infinity());
-    frameBuffer.assign(sz, bkColor);
+    f.zBuffer.assign(sz, numeric_limits<float>::infinity());
+    f.frameBuffer.assign(sz, bkColor);
+    f.bins.assign(tilesX * tilesY, {});
+    f.tileStats.resize(tilesX * tilesY);
 }
-static void computeBarycentric2D(double x, double y, const Triangle &t, double *param)
+// 坐标先平移到以 c 为原点再求面积，单精度下不会因大数相减丢失精度
+static void computeBarycentric2D(real x, real y, const Triangle &t, real *param)
 {
-    double xa = t.getVertex(0).data[0], ya = t.getVertex(0).data[1];
-    double xb = t.getVertex(1).data[0], yb = t.getVertex(1).data[1];
-    double xc = t.getVertex(2).data[0], yc = t.getVertex(2).data[1];
-    param[0] = (x * (yb - yc) + (xc - xb) * y + xb * yc - xc * yb) / (xa * (yb - yc) + (xc - xb) * ya + xb * yc - xc * yb);
-    param[1] = (x * (yc - ya) + (xa - xc) * y + xc * ya - xa * yc) / (xb * (yc - ya) + (xa - xc) * yb + xc * ya - xa * yc);
-    param[2] = (x * (ya - yb) + (xb - xa) * y + xa * yb - xb * ya) / (xc * (ya - yb) + (xb - xa) * yc + xa * yb - xb * ya);
+    real xc = t.getVertex(2).data[0], yc = t.getVertex(2).data[1];
+    real xa = t.getVertex(0).data[0] - xc, ya = t.getVertex(0).data[1] - yc;
+    real xb = t.getVertex(1).data[0] - xc, yb = t.getVertex(1).data[1] - yc;
+    x -= xc;
+    y -= yc;
+    real invArea = 1 / (xa * yb - xb * ya);
+    param[0] = (x * yb - xb * y) * invArea;
+    param[1] = (xa * y - x * ya) * invArea;
+    param[2] = 1 - param[0] - param[1];
 }
 double calculateIntersection(double c, const Point &p1, const Point &p2)
 {
@@ -79,193 +84,847 @@ optional<pair<int, int>> findIntersections(double c, const Point &A, const Point
     return make_optional<pair<int, int>>(ceil(intersections.front()), intersections.back());
 }
 
-void rasterizer::drawTriangle(Triangle tri, Triangle ctri, const model &mod, int startX, int endX, bool mutiThread)
+void rasterizer::drawTriangle(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY)
 {
-
     for (int i = startX; i < endX; i++)
     {
-        auto opt = findIntersections(i, tri.getVertex(0), tri.getVertex(1), tri.getVertex(2));
+        auto opt = findIntersections(i, rt.tri.getVertex(0), rt.tri.getVertex(1), rt.tri.getVertex(2));
         if (opt)
         {
             auto [p1, p2] = *opt;
-            p1 = max(0, p1);
-            p2 = min(height - 1, p2);
-            if (mutiThread)
-                threads.push_back(poolIns.assign(bind(&rasterizer::rasterizeLine, this, tri, ctri, ref(mod), i, p1, p2)));
-            else
-                rasterizeLine(tri, ctri, mod, i, p1, p2);
+            p1 = max(startY, p1);
+            p2 = min(endY - 1, p2);
+            rasterizeLine(tile, rt, i, p1, p2);
         }
     }
 }
 
-void rasterizer::rasterizeLine(Triangle tri, Triangle ctri, const model &mod, int x, int startY, int endY)
+void rasterizer::rasterizeLine(tileBuffer &tile, const rasterTriangle &rt, int x, int startY, int endY)
 {
     for (int j = startY; j <= endY; j++)
     {
-        double param[3];
-        computeBarycentric2D(x, j, tri, param);
-        vec3 p, p2;
-        for (int i = 0; i < 3; i++)
-            for (int j = 0; j < 3; j++)
-            {
-                p[i] += param[j] * tri.getVertex(j)[i];
-                p2[i] += param[j] * ctri.getVertex(j)[i];
-            }
-        float z = float(-p[2]);
-        if (z >= zBuffer[j * width + x])
-            continue;
+        real param[3];
+        computeBarycentric2D(real(x), real(j), rt.tri, param);
+        shadeFragment(tile, rt, x, j, param);
+    }
+}
 
-        double r = 0, g = 0, b = 0;
-        for (int i = 0; i < 3; i++)
-        {
-            r += param[i] * tri.colorR[i];
-            g += param[i] * tri.colorG[i];
-            b += param[i] * tri.colorB[i];
-        }
+// 半平面边函数: e(p) = (v2 - v1) x (p - v1)，三条边的值即未归一化的重心坐标
+// 每个三角形只做一次 setup，像素间 / 行间只需加法步进
+bool rasterizer::setupEdges(const Triangle &tri, int startX, int startY, edgeSetup &e)
+{
+    // 保护带内坐标不超过 2^15 像素，吸附后 2^23，边函数乘积在 2^48 以内，int64 不会溢出
+    int64_t vx[3], vy[3];
+    for (int i = 0; i < 3; i++)
+    {
+        vx[i] = llround(double(tri.getVertex(i).data[0]) * edgeSetup::subPixel);
+        vy[i] = llround(double(tri.getVertex(i).data[1]) * edgeSetup::subPixel);
+    }
+    int64_t area = (vx[1] - vx[0]) * (vy[2] - vy[0]) - (vy[1] - vy[0]) * (vx[2] - vx[0]);
+    if (area == 0)
+        return false;
+    int64_t sign = area > 0 ? 1 : -1;
+    e.invArea = 1 / real(area * sign);
 
-        vec3 nor;
-        double uTex = 0, vTex = 0;
-        for (int i = 0; i < 3; i++)
-        {
-            nor += tri.normal[i].value() * param[i];
-            uTex += tri.uTex[i] * param[i];
-            vTex += tri.vTex[i] * param[i];
-        }
-        // nor.abs();
+    // 顶点 i 的权重来自其对边 (v[i+1], v[i+2])
+    int64_t px = int64_t(startX) << edgeSetup::subPixelBits, py = int64_t(startY) << edgeSetup::subPixelBits;
+    for (int i = 0; i < 3; i++)
+    {
+        int j = (i + 1) % 3, k = (i + 2) % 3;
+        int64_t dx = vx[k] - vx[j], dy = vy[k] - vy[j];
+        e.stepX[i] = -dy * sign * edgeSetup::subPixel;
+        e.stepY[i] = dx * sign * edgeSetup::subPixel;
+        e.rowW[i] = (dx * (py - vy[j]) - dy * (px - vx[j])) * sign;
+        // top-left 规则: 落在边上的像素只归属于共享该边的其中一个三角形
+        e.topLeft[i] = e.stepX[i] > 0 || (e.stepX[i] == 0 && e.stepY[i] > 0);
+    }
+    return true;
+}
+void rasterizer::drawTriangleEdge(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY)
+{
+    edgeSetup e;
+    if (!setupEdges(rt.tri, startX, startY, e))
+        return;
 
-        // vec3 color = texColor;
-        vec3 color;
-        vec3 baseColor = mod.pTextureData ? mod.getTexColor(uTex, vTex) : vec3(r, g, b);
-        if (lig.lightPos.empty())
-            color = baseColor;
-        else
-            color = lig(p2, nor, baseColor, pCam ? pCam->pos : vec3(0, 0, 1));
-        // vec3 color = lig(p2, nor, vec3(r, g, b), pCam->pos);
-        // vec3 color = (nor + vec3(1, 1, 1)) * 255 / 2.0;
-        float oldValue = zBuffer[j * width + x].load();
-        while (z < oldValue)
+    for (int y = startY; y < endY; y++)
+    {
+        int64_t w[3] = {e.rowW[0], e.rowW[1], e.rowW[2]};
+        for (int x = startX; x < endX; x++)
         {
-            if (zBuffer[j * width + x].compare_exchange_weak(oldValue, z))
+            bool inside = true;
+            for (int i = 0; i < 3; i++)
+                inside &= w[i] > 0 || (w[i] == 0 && e.topLeft[i]);
+            if (inside)
             {
-                setPixel(j, x, color[0], color[1], color[2]);
-                break;
+                real param[3] = {real(w[0]) * e.invArea, real(w[1]) * e.invArea, real(w[2]) * e.invArea};
+                shadeFragment(tile, rt, x, y, param);
             }
+            for (int i = 0; i < 3; i++)
+                w[i] += e.stepX[i];
         }
+        for (int i = 0; i < 3; i++)
+            e.rowW[i] += e.stepY[i];
+    }
+}
+
+void rasterizer::shadeFragment(tileBuffer &tile, const rasterTriangle &rt, int x, int y, const real *param)
+{
+    const Triangle &tri = rt.tri, &ctri = rt.ctri;
+    real pz = 0;
+    for (int j = 0; j < 3; j++)
+        pz += param[j] * tri.getVertex(j).data[2];
+    float z = float(-pz);
+    int idx = (y - tile.y0) * tileBuffer::size + (x - tile.x0);
+    if (tile.pass == fragmentPass::depthEqual ? z != tile.depth[idx] : z >= tile.depth[idx])
+        return;
+    if (tile.pass != fragmentPass::depthEqual)
+    {
+        tile.stats.depthPassed++;
+        tile.depth[idx] = z;
+    }
+    if (tile.pass == fragmentPass::depthOnly)
+        return;
+    if (tile.pass == fragmentPass::visibility)
+    {
+        tile.id[idx] = uint32_t(&rt - tile.frame->rasterTris.data());
+        return;
+    }
+    tile.stats.shaded++;
+
+    vec3 p2;
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            p2[i] += param[j] * ctri.getVertex(j).data[i];
+
+    real r = 0, g = 0, b = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        r += param[i] * real(tri.colorR[i]);
+        g += param[i] * real(tri.colorG[i]);
+        b += param[i] * real(tri.colorB[i]);
+    }
+
+    vec3 nor;
+    real uTex = 0, vTex = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        vec3 n = *tri.normal[i];
+        nor += n * param[i];
+        uTex += tri.uTex[i] * param[i];
+        vTex += tri.vTex[i] * param[i];
+    }
+    tile.color[idx] = shadePixel(tile, rt, p2, nor, uTex, vTex, vec3(r, g, b));
+}
+
+uint32_t rasterizer::shadePixel(const tileBuffer &tile, const rasterTriangle &rt, vec3 pos, vec3 nor, real u, real v, vec3 vertexColor)
+{
+    // nor.abs();
+
+    // vec3 color = texColor;
+    vec3 color;
+    vec3 baseColor = rt.mod->pTextureData ? rt.mod->getTexColor(u, v) : vertexColor;
+    if (lig.lightPos.empty())
+        color = baseColor;
+    else
+        color = lig(pos, nor, baseColor, tile.frame->eye);
+    // vec3 color = lig(p2, nor, vec3(r, g, b), pCam->pos);
+    // vec3 color = (nor + vec3(1, 1, 1)) * 255 / 2.0;
+    return (int(color[0]) << 16) | (int(color[1]) << 8) | int(color[2]);
+}
+
+void rasterizer::fillBatch(const rasterTriangle &rt, const real *param, fragmentBatch &batch, int lane)
+{
+    const Triangle &tri = rt.tri, &ctri = rt.ctri;
+    real v[12] = {};
+    for (int i = 0; i < 3; i++)
+    {
+        vec3 n = *tri.normal[i];
+        real attr[12] = {ctri.getVertex(i).data[0], ctri.getVertex(i).data[1], ctri.getVertex(i).data[2],
+                         n[0], n[1], n[2], tri.uTex[i], tri.vTex[i],
+                         real(tri.colorR[i]), real(tri.colorG[i]), real(tri.colorB[i])};
+        for (int k = 0; k < 11; k++)
+            v[k] += attr[k] * param[i];
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        batch.pos[c][lane] = float(v[c]);
+        batch.nor[c][lane] = float(v[3 + c]);
+        batch.color[c][lane] = float(v[8 + c]);
     }
+    batch.u[lane] = float(v[6]);
+    batch.v[lane] = float(v[7]);
 }
 
-void rasterizer::setPixel(int x, int y, int r, int g, int b)
+void rasterizer::shadeBatch(const tileBuffer &tile, const rasterTriangle &rt, fragmentBatch &batch, uint32_t *color)
+{
+    if (rt.mod->pTextureData)
+        rt.mod->getTexColor(batch);
+    if (!lig.lightPos.empty())
+        lig(batch, tile.frame->eye);
+    for (int i = 0; i < batch.count; i++)
+        color[i] = (int(batch.color[0][i]) << 16) | (int(batch.color[1][i]) << 8) | int(batch.color[2][i]);
+}
+
+void rasterizer::setPixel(frameContext &f, int x, int y, int r, int g, int b)
 {
     x = height - x - 1; // 翻转y坐标
-    frameBuffer[x * width + y] = (r << 16) | (g << 8) | b;
+    f.frameBuffer[x * width + y] = (r << 16) | (g << 8) | b;
 }
 
-rasterizer::rasterizer(int width, int height) : width(width), height(height), resize(true), poolIns(ThreadPool::getInstance())
+rasterizer::rasterizer(int width, int height, ThreadPool &pool) : width(width), height(height), resize(true), poolIns(pool)
 {
+    for (auto &f : frames)
+        f = make_unique<frameContext>(pool);
 }
 void rasterizer::setRasterizeSize(int _width, int _height)
 {
+    finish();
     width = _width;
     height = _height;
     resize = true;
 }
 
-std::span<uint32_t> rasterizer::draw()
+modelTransform rasterizer::getModelMatrix(frameContext &f, const Matrix &modelMatrix, cullMode cull)
 {
-    static future<void> cls;
-    static Matrix viewpointMatrix;
-    static Matrix vpv;
-    if (pCam && resize)
+    modelTransform res;
+    res.cull = cull;
+    float4x4 mm(modelMatrix);
+    if (pCam)
     {
-        pCam->resize(width, height);
-        resize = false;
-        cls = async(&rasterizer::clearBuffer, this);
+        res.mvpv = f.vpv * mm;
+        res.mv = f.view * mm;
+    }
+    else
+    {
+        res.mvpv = float4x4(viewportMatrix) * mm;
+        res.mv = mm;
+    }
+    res.normal = res.mv.normalMatrix();
+    return res;
+}
 
-        viewpointMatrix = {
-            {width / 2., 0, 0, width / 2.},
-            {0, height / 2., 0, height / 2.},
-            {0, 0, 1, 0},
-            {0, 0, 0, 1}};
-        
+// 顶点阶段：一批唯一顶点各变换一次，结果写入 out 中 base 起的对应下标
+void rasterizer::transformVertices(const model &m, const modelTransform &mt, vertexStream &out, size_t base, size_t begin, size_t end)
+{
+    const vertexBuffer &vb = m.verts;
+    size_t n = end - begin;
+    span<const vec4> pos(vb.pos.data() + begin, n);
+    transformPoints(mt.mvpv, pos, {out.clip.data() + base + begin, n});
+    transformPoints(mt.mv, pos, {out.view.data() + base + begin, n});
+    transformPoints(mt.normal, {vb.nor.data() + begin, n}, {out.nor.data() + base + begin, n});
+    for (size_t i = base + begin; i < base + end; i++)
+    {
+        const vec4 &c = out.clip[i];
+        out.screen[i] = {c.x / c.w, c.y / c.w, c.z / c.w, 1};
     }
-    if (pCam)
-        vpv = viewpointMatrix * pCam->projectionMatrix * pCam->viewMatrix;
+}
+
+// 从变换后的顶点按下标装配三角形，clipSpace 为真时顶点取裁剪空间坐标，否则取屏幕坐标
+Triangle rasterizer::assembleTriangle(const model &m, const vertexStream &vs, size_t base, const uint32_t *idx, bool clipSpace)
+{
+    const vertexBuffer &vb = m.verts;
+    Triangle res;
+    for (int i = 0; i < 3; i++)
+    {
+        const vec4 &p = (clipSpace ? vs.clip : vs.screen)[base + idx[i]];
+        res.ver[i] = {p.x, p.y, p.z, p.w};
+        const vec4 &n = vs.nor[base + idx[i]];
+        if (n.x != 0 || n.y != 0 || n.z != 0)
+            res.normal[i] = vec3(n.x, n.y, n.z);
+        res.uTex[i] = vb.u[idx[i]];
+        res.vTex[i] = vb.v[idx[i]];
+        res.colorR[i] = vb.r[idx[i]];
+        res.colorG[i] = vb.g[idx[i]];
+        res.colorB[i] = vb.b[idx[i]];
+    }
+    return res;
+}
 
-    if (cls.valid())
-        cls.get();
-    // const vec3 &view_pos = pCam->pos;
+Triangle rasterizer::assembleView(const vertexStream &vs, size_t base, const uint32_t *idx)
+{
+    Triangle res;
+    for (int i = 0; i < 3; i++)
+    {
+        const vec4 &p = vs.view[base + idx[i]];
+        res.ver[i] = {p.x, p.y, p.z, 1};
+    }
+    return res;
+}
 
-    for (auto mref : models)
+void rasterizer::emitTriangle(frameContext &f, const model &m, cullMode cull, Triangle tri, const Triangle &ctri)
+{
+    // 屏幕空间有向面积：逆时针为正面；零面积三角形不覆盖任何像素，且会让重心坐标除零
+    real ax = tri.getVertex(0)[0], ay = tri.getVertex(0)[1];
+    real bx = tri.getVertex(1)[0], by = tri.getVertex(1)[1];
+    real cx = tri.getVertex(2)[0], cy = tri.getVertex(2)[1];
+    real area = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+    if (area == 0 || (cull == cullMode::back && area < 0) || (cull == cullMode::front && area > 0))
     {
-        model &m = mref.get();
-        Matrix mvpv, mv;
-        if (pCam)
+        f.stats.culled++;
+        return;
+    }
+
+    vec3 ab(ctri.getVertex(1).data[0] - ctri.getVertex(0).data[0], ctri.getVertex(1).data[1] - ctri.getVertex(0).data[1], ctri.getVertex(1).data[2] - ctri.getVertex(0).data[2]);
+    vec3 ac(ctri.getVertex(2).data[0] - ctri.getVertex(0).data[0], ctri.getVertex(2).data[1] - ctri.getVertex(0).data[1], ctri.getVertex(2).data[2] - ctri.getVertex(0).data[2]);
+    vec3 nor = (ab.cross(ac)).normalize();
+    for (int i = 0; i < 3; i++)
+    {
+        if (tri.normal[i])
+            tri.normal[i] = tri.normal[i]->normalize();
+        else
+            tri.normal[i] = nor;
+    }
+    int minx = min({ax, bx, cx});
+    int maxx = max({ax, bx, cx});
+    int miny = min({ay, by, cy});
+    int maxy = max({ay, by, cy});
+
+    rasterTriangle rt{tri, ctri, &m, max(0, minx), min(width, maxx + 1), max(0, miny), min(height, maxy + 1),
+                      float(-max({tri.getVertex(0)[2], tri.getVertex(1)[2], tri.getVertex(2)[2]}))};
+    if (rt.minX < rt.maxX && rt.minY < rt.maxY)
+        f.rasterTris.push_back(rt);
+}
+
+// 装配阶段：按下标取变换后的顶点组成三角形，裁剪后交给 emitTriangle
+void rasterizer::setupTriangles(frameContext &f, int i)
+{
+    const model &m = *f.drawList[i];
+    size_t base = f.vertexBase[i];
+    cullMode cull = f.modelMats[i].cull;
+    const vertexStream &vs = f.vertexOut;
+    if (!pCam)
+    {
+        for (int t = 0; t < m.triangleCount(); t++)
         {
-            mvpv = vpv * m.modelMatrix;
-            mv = pCam->viewMatrix * m.modelMatrix;
+            uint32_t idx[3];
+            m.indices.triangle(t, idx);
+            emitTriangle(f, m, cull, assembleTriangle(m, vs, base, idx, false), assembleView(vs, base, idx));
         }
-        else
+        return;
+    }
+
+    // 裁剪面写成齐次坐标 (x, y, z, w) 的线性函数，>= 0 为内侧。视口变换不改 z / w，可直接在 mvpv 之后裁剪
+    // 投影矩阵令 w 为观察空间 z，可见点 w < 0；近平面之后 w 恒为负，保护带平面才成立
+    const double G = guardBand;
+    const double planes[clipPlaneCount][4] = {
+        {0, 0, 1, -1},              // 近
+        {0, 0, -1, -1},             // 远
+        {-1, 0, 0, -G},             // x >= -G
+        {1, 0, 0, -(width + G)},    // x <= width + G
+        {0, -1, 0, -G},             // y >= -G
+        {0, 1, 0, -(height + G)},   // y <= height + G
+    };
+    const unsigned nearBit = 1, depthBits = 3;
+    for (int t = 0; t < m.triangleCount(); t++)
+    {
+        uint32_t idx[3];
+        m.indices.triangle(t, idx);
+        double dist[clipPlaneCount][3];
+        unsigned outAny = 0, outAll = ~0u;
+        for (int i = 0; i < 3; i++)
         {
-            mvpv = viewpointMatrix * m.modelMatrix;
-            mv = m.modelMatrix;
+            unsigned out = 0;
+            const vec4 &v = vs.clip[base + idx[i]];
+            for (int k = 0; k < clipPlaneCount; k++)
+            {
+                dist[k][i] = planes[k][0] * v.x + planes[k][1] * v.y + planes[k][2] * v.z + planes[k][3] * v.w;
+                out |= (dist[k][i] < 0) << k;
+            }
+            outAny |= out;
+            outAll &= out;
         }
-        // clearBuffer();
-        for (auto p : m.lines)
+        if (!outAny)
         {
-            Triangle tri = {p.first, p.second, Point{}};
-            tri = (mvpv * tri).normalize();
-            drawLine(tri.getVertex(0), tri.getVertex(1));
+            emitTriangle(f, m, cull, assembleTriangle(m, vs, base, idx, false), assembleView(vs, base, idx));
+            continue;
         }
+        f.stats.clipped++;
+        // 全在近 / 远平面外，或全部位于相机前方且全在同一保护带平面外
+        if ((outAll & depthBits) || (outAll && !(outAny & nearBit)))
+            continue;
 
-        for (Triangle ctri : m.tris)
+        // Sutherland-Hodgman，多边形顶点记为原三角形的重心坐标；裁剪空间坐标与顶点属性都对其线性
+        double poly[2][maxClipVerts][3], w[3][3];
+        int n = 3, cur = 0;
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                poly[0][i][j] = i == j;
+        for (int k = 0; k < clipPlaneCount && n; k++)
         {
-            Triangle tri = (mvpv * ctri).normalize();
-            Triangle test = mvpv * ctri;
-            ctri = (mv * ctri).normalize();
+            if (!(outAny >> k & 1))
+                continue;
+            auto d = [&](const double *b)
+            { return b[0] * dist[k][0] + b[1] * dist[k][1] + b[2] * dist[k][2]; };
+            int cnt = 0;
+            for (int i = 0; i < n; i++)
+            {
+                const double *p = poly[cur][i], *q = poly[cur][(i + 1) % n];
+                double dp = d(p), dq = d(q);
+                if (dp >= 0)
+                    copy_n(p, 3, poly[cur ^ 1][cnt++]);
+                if ((dp >= 0) != (dq >= 0))
+                {
+                    double t = dp / (dp - dq);
+                    for (int j = 0; j < 3; j++)
+                        poly[cur ^ 1][cnt][j] = p[j] + (q[j] - p[j]) * t;
+                    cnt++;
+                }
+            }
+            n = cnt;
+            cur ^= 1;
+        }
+        if (n < 3)
+            continue;
+        Triangle clip = assembleTriangle(m, vs, base, idx, true), view = assembleView(vs, base, idx);
+        for (int i = 1; i + 1 < n; i++)
+        {
+            copy_n(poly[cur][0], 3, w[0]);
+            copy_n(poly[cur][i], 3, w[1]);
+            copy_n(poly[cur][i + 1], 3, w[2]);
+            emitTriangle(f, m, cull, clip.subTriangle(w).normalize(), view.subTriangle(w));
+        }
+    }
+}
 
-            vec3 ab(ctri.getVertex(1)[0] - ctri.getVertex(0)[0], ctri.getVertex(1)[1] - ctri.getVertex(0)[1], ctri.getVertex(1)[2] - ctri.getVertex(0)[2]);
-            vec3 ac(ctri.getVertex(2)[0] - ctri.getVertex(0)[0], ctri.getVertex(2)[1] - ctri.getVertex(0)[1], ctri.getVertex(2)[2] - ctri.getVertex(0)[2]);
-            vec3 nor = (ab.cross(ac)).normalize();
-            for (int i = 0; i < 3; i++)
+// sort-middle: 按包围盒把三角形分配到所有覆盖的屏幕块，块内保持提交顺序
+void rasterizer::binTriangles(frameContext &f)
+{
+    for (auto &bin : f.bins)
+        bin.clear();
+    for (int i = 0; i < int(f.rasterTris.size()); i++)
+    {
+        const rasterTriangle &rt = f.rasterTris[i];
+        int tx0 = rt.minX / tileBuffer::size, tx1 = (rt.maxX - 1) / tileBuffer::size;
+        int ty0 = rt.minY / tileBuffer::size, ty1 = (rt.maxY - 1) / tileBuffer::size;
+        for (int ty = ty0; ty <= ty1; ty++)
+            for (int tx = tx0; tx <= tx1; tx++)
+                f.bins[ty * tilesX + tx].push_back(i);
+    }
+}
+
+float tileBuffer::maxDepth(int bx, int by)
+{
+    int b = by * blocks + bx;
+    if (blockDirty[b])
+    {
+        float res = -numeric_limits<float>::infinity();
+        int w = min(blockSize, x1 - x0 - bx * blockSize), h = min(blockSize, y1 - y0 - by * blockSize);
+        for (int y = 0; y < h; y++)
+        {
+            const float *row = depth + (by * blockSize + y) * size + bx * blockSize;
+            res = max(res, *max_element(row, row + w));
+        }
+        blockMaxZ[b] = res;
+        blockDirty[b] = false;
+    }
+    return blockMaxZ[b];
+}
+
+// 可见性缓冲的解析: 按编号找回三角形，在像素处重算重心坐标后着色
+// 同一模型(同一张纹理)的连续像素攒成一批，交给 SIMD 纹理采样与光照
+void rasterizer::resolveTile(tileBuffer &tile, simdLevel level)
+{
+    fragmentBatch batch;
+    uint32_t color[fragmentBatch::maxCount];
+    int lanePixel[fragmentBatch::maxCount];
+    int n = 0;
+    const int laneWidth = level == simdLevel::avx512 ? 16 : level == simdLevel::avx2 ? 8 : level == simdLevel::sse4 ? 4 : 1;
+    const rasterTriangle *batchTri = nullptr;
+    auto flush = [&]
+    {
+        if (!n)
+            return;
+        // 凑齐当前指令集的宽度，保证整批走向量路径；补齐的通道复制第一个片元，算完丢弃
+        int count = (n + laneWidth - 1) / laneWidth * laneWidth;
+        batch.replicateLane(0, n, count);
+        batch.count = count;
+        shadeBatch(tile, *batchTri, batch, color);
+        for (int i = 0; i < n; i++)
+            tile.color[lanePixel[i]] = color[i];
+        tile.stats.shaded += n;
+        n = 0;
+    };
+
+    for (int y = tile.y0; y < tile.y1; y++)
+        for (int x = tile.x0; x < tile.x1; x++)
+        {
+            int idx = (y - tile.y0) * tileBuffer::size + (x - tile.x0);
+            if (tile.id[idx] == tileBuffer::noTriangle)
+                continue;
+            const rasterTriangle &rt = tile.frame->rasterTris[tile.id[idx]];
+            if (n == fragmentBatch::maxCount || (n && rt.mod != batchTri->mod))
+                flush();
+            edgeSetup e;
+            setupEdges(rt.tri, x, y, e);
+            real param[3] = {real(e.rowW[0]) * e.invArea, real(e.rowW[1]) * e.invArea, real(e.rowW[2]) * e.invArea};
+            fillBatch(rt, param, batch, n);
+            batchTri = &rt;
+            lanePixel[n++] = idx;
+        }
+    flush();
+}
+
+void rasterizer::rasterizeRect(tileBuffer &tile, const rasterTriangle &rt, simdLevel level, int startX, int endX, int startY, int endY)
+{
+    if (mode == rasterizeMode::scanLine)
+        return drawTriangle(tile, rt, startX, endX, startY, endY);
+    switch (level)
+    {
+    case simdLevel::avx512:
+        return drawTriangleAvx512(tile, rt, startX, endX, startY, endY);
+    case simdLevel::avx2:
+        return drawTriangleAvx2(tile, rt, startX, endX, startY, endY);
+    case simdLevel::sse4:
+        return drawTriangleSse4(tile, rt, startX, endX, startY, endY);
+    default:
+        return drawTriangleEdge(tile, rt, startX, endX, startY, endY);
+    }
+}
+
+void rasterizer::rasterizeBin(tileBuffer &tile, int idx, simdLevel level)
+{
+    const int bs = tileBuffer::blockSize;
+    // 边函数是定点整数，像素的重心坐标与深度和遍历起点无关，预深度的两遍按小块拆分后深度仍逐位相等
+    bool equal = tile.pass == fragmentPass::depthEqual;
+    for (int i : tile.frame->bins[idx])
+    {
+        const rasterTriangle &rt = tile.frame->rasterTris[i];
+        int startX = max(rt.minX, tile.x0), endX = min(rt.maxX, tile.x1);
+        int startY = max(rt.minY, tile.y0), endY = min(rt.maxY, tile.y1);
+        if (!hiZ)
+        {
+            rasterizeRect(tile, rt, level, startX, endX, startY, endY);
+            continue;
+        }
+
+        // 三角形最近的深度都不比小块里最远的深度近，则整块都通不过深度测试
+        // 未刷新的 blockMaxZ 只会偏大，仍可安全剔除；小三角形直接用它，避免每次都重算小块
+        bool refresh = (endX - startX) * (endY - startY) >= bs * bs;
+        auto occluded = [&](int bx, int by)
+        {
+            float far = refresh ? tile.maxDepth(bx, by) : tile.blockMaxZ[by * tileBuffer::blocks + bx];
+            return equal ? rt.minZ > far : rt.minZ >= far;
+        };
+        int bx0 = (startX - tile.x0) / bs, bx1 = (endX - 1 - tile.x0) / bs;
+        int by0 = (startY - tile.y0) / bs, by1 = (endY - 1 - tile.y0) / bs;
+        int occludedCount = 0;
+        for (int by = by0; by <= by1; by++)
+            for (int bx = bx0; bx <= bx1; bx++)
+                occludedCount += occluded(bx, by);
+        if (occludedCount == (bx1 - bx0 + 1) * (by1 - by0 + 1))
+            continue;
+
+        // 深度相等测试不改写深度，无需标脏
+        auto markDirty = [&](int by, int bxs, int bxe)
+        {
+            if (!equal)
+                fill(tile.blockDirty + by * tileBuffer::blocks + bxs, tile.blockDirty + by * tileBuffer::blocks + bxe + 1, true);
+        };
+        if (!occludedCount)
+        {
+            rasterizeRect(tile, rt, level, startX, endX, startY, endY);
+            for (int by = by0; by <= by1; by++)
+                markDirty(by, bx0, bx1);
+            continue;
+        }
+
+        // 逐行扫描小块，连续可见的小块合并成一段再光栅化
+        for (int by = by0; by <= by1; by++)
+        {
+            int ys = max(startY, tile.y0 + by * bs), ye = min(endY, tile.y0 + (by + 1) * bs);
+            for (int bx = bx0; bx <= bx1; bx++)
             {
-                if (tri.normal[i])
-                    tri.normal[i] = (mv * tri.normal[i].value()).normalize();
-                else
-                    tri.normal[i] = nor;
+                if (occluded(bx, by))
+                    continue;
+                int runEnd = bx;
+                while (runEnd < bx1 && !occluded(runEnd + 1, by))
+                    runEnd++;
+                int xs = max(startX, tile.x0 + bx * bs), xe = min(endX, tile.x0 + (runEnd + 1) * bs);
+                rasterizeRect(tile, rt, level, xs, xe, ys, ye);
+                markDirty(by, bx, runEnd);
+                bx = runEnd;
             }
-            double ax = tri.getVertex(0)[0], ay = tri.getVertex(0)[1];
-            double bx = tri.getVertex(1)[0], by = tri.getVertex(1)[1];
-            double cx = tri.getVertex(2)[0], cy = tri.getVertex(2)[1];
-
-            int minx = min({ax, bx, cx});
-            int maxx = max({ax, bx, cx});
-            int miny = min({ay, by, cy});
-            int maxy = max({ay, by, cy});
-
-            int endx = min(width, maxx + 1);
-            int startx = max(0, minx);
-            int endy = min(height, maxy + 1);
-            int starty = max(0, miny);
-            bool interThread = (endy - starty > 100);
-            if (interThread)
-                drawTriangle(tri, ctri, m, startx, endx, true);
-            else
-                threads.push_back(poolIns.assign(bind(&rasterizer::drawTriangle, this, tri, ctri, ref(m), startx, endx, false)));
         }
     }
-    for (auto &f : threads)
-        f.get();
-    threads.clear();
-    cls = async(&rasterizer::clearBuffer, this);
-    return span<uint32_t>(frameBuffer);
+}
+
+void rasterizer::rasterizeTile(frameContext &f, int idx)
+{
+    tileBuffer tile;
+    tile.frame = &f;
+    tile.x0 = idx % tilesX * tileBuffer::size;
+    tile.y0 = idx / tilesX * tileBuffer::size;
+    tile.x1 = min(width, tile.x0 + tileBuffer::size);
+    tile.y1 = min(height, tile.y0 + tileBuffer::size);
+    fill_n(tile.depth, tileBuffer::size * tileBuffer::size, numeric_limits<float>::infinity());
+    fill_n(tile.color, tileBuffer::size * tileBuffer::size, bkColor);
+    fill_n(tile.blockMaxZ, tileBuffer::blocks * tileBuffer::blocks, numeric_limits<float>::infinity());
+    fill_n(tile.blockDirty, tileBuffer::blocks * tileBuffer::blocks, false);
+    simdLevel level = cpuFeature::level();
+
+    switch (pipeline)
+    {
+    case renderPipeline::depthPrepass:
+        // 先只写深度，再用相等测试只给可见片元着色
+        tile.pass = fragmentPass::depthOnly;
+        rasterizeBin(tile, idx, level);
+        tile.pass = fragmentPass::depthEqual;
+        break;
+    case renderPipeline::visibility:
+        tile.pass = fragmentPass::visibility;
+        fill_n(tile.id, tileBuffer::size * tileBuffer::size, tileBuffer::noTriangle);
+        break;
+    default:
+        tile.pass = fragmentPass::shade;
+    }
+    rasterizeBin(tile, idx, level);
+
+    if (tile.pass == fragmentPass::visibility)
+        resolveTile(tile, level);
+
+    // 写回整帧缓冲，每块区域互不重叠
+    int w = tile.x1 - tile.x0;
+    for (int y = tile.y0; y < tile.y1; y++)
+    {
+        int row = (y - tile.y0) * tileBuffer::size;
+        copy_n(tile.depth + row, w, f.zBuffer.begin() + y * width + tile.x0);
+        copy_n(tile.color + row, w, f.frameBuffer.begin() + (height - y - 1) * width + tile.x0);
+        tile.stats.coveredPixels += count_if(tile.depth + row, tile.depth + row + w, [](float z)
+                                             { return z != numeric_limits<float>::infinity(); });
+    }
+    f.tileStats[idx] = tile.stats;
+}
+
+void rasterizer::transformModel(frameContext &f, int i)
+{
+    size_t base = f.vertexBase[i], n = f.vertexBase[i + 1] - base;
+    poolIns.parallelFor(&f.arena, 0, n, 0, [this, &f, i, base](size_t lo, size_t hi)
+                        { transformVertices(*f.drawList[i], f.modelMats[i], f.vertexOut, base, lo, hi); });
+}
+void rasterizer::rasterizeTiles(frameContext &f)
+{
+    // 每个块都会写满自己的深度 / 颜色，无需再清空整帧
+    poolIns.parallelFor(&f.arena, 0, tilesX * tilesY, 1, [this, &f](size_t lo, size_t hi)
+                        {
+        for (size_t i = lo; i < hi; i++)
+            rasterizeTile(f, int(i)); });
+}
+void rasterizer::present(frameContext &f)
+{
+    for (auto &s : f.tileStats)
+        f.stats += s;
+
+    for (size_t i = 0; i < f.drawList.size(); i++)
+        for (auto p : f.drawList[i]->lines)
+        {
+            vec4 v[2] = {{float(p.first[0]), float(p.first[1]), float(p.first[2]), float(p.first[3])},
+                         {float(p.second[0]), float(p.second[1]), float(p.second[2]), float(p.second[3])}};
+            transformPoints(f.modelMats[i].mvpv, v, v);
+            drawLine(f, Point{v[0].x / v[0].w, v[0].y / v[0].w, v[0].z / v[0].w, 1},
+                     Point{v[1].x / v[1].w, v[1].y / v[1].w, v[1].z / v[1].w, 1}, {255, 255, 255});
+        }
+}
+
+void rasterizer::addToFrame(frameContext &f, const model &m, const Matrix &modelMatrix, cullMode cull)
+{
+    f.drawList.push_back(&m);
+    f.modelMats.push_back(getModelMatrix(f, modelMatrix, cull));
+    f.vertexBase.push_back(f.vertexBase.back() + m.verts.size());
+}
+
+// 包围球在屏幕上的半径（像素），只用于排载入优先级：完全在相机背后为 0，相机在球内取整屏高度
+float rasterizer::screenRadius(const Matrix &modelMatrix, const meshBounds &bounds) const
+{
+    float4x4 mm(modelMatrix);
+    vec4 c = mm * vec4{bounds.center[0], bounds.center[1], bounds.center[2], 1};
+    float scale = 0;
+    for (int j = 0; j < 3; j++)
+        scale = max(scale, sqrt(mm.m[0][j] * mm.m[0][j] + mm.m[1][j] * mm.m[1][j] + mm.m[2][j] * mm.m[2][j]));
+    float r = bounds.radius * scale;
+    if (!pCam)
+        return r * height / 2;
+    // 观察空间中可见点 z < 0
+    float depth = -(float4x4(pCam->viewMatrix) * c).z;
+    if (depth <= -r)
+        return 0;
+    if (depth <= r)
+        return float(height);
+    return r / float(tan(pCam->fov / 2)) / depth * height / 2;
+}
+
+// 记录本帧的相机与模型矩阵快照，建好阶段依赖图后立即开始执行，不等待完成
+void rasterizer::submitFrame(frameContext &f, bool resized)
+{
+    if (pCam)
+    {
+        f.vpv = float4x4(viewportMatrix * pCam->projectionMatrix * pCam->viewMatrix);
+        f.view = float4x4(pCam->viewMatrix);
+        f.eye = pCam->pos;
+    }
+    else
+        f.eye = vec3(0, 0, 1);
+
+    f.stats = {};
+    // 本帧的模型列表：资源在提交时才决定画本体、占位还是跳过，在飞行中的帧不受之后载入完成的影响
+    f.drawList.clear();
+    f.modelMats.clear();
+    f.vertexBase.assign(1, 0);
+    for (auto &s : models)
+    {
+        if (s.mod)
+        {
+            addToFrame(f, *s.mod, s.mod->modelMatrix, s.mod->cull);
+            continue;
+        }
+        modelAsset &a = *s.asset;
+        assetState state = a.getState();
+        if (state == assetState::ready)
+            addToFrame(f, a.geometry, a.modelMatrix, a.cull);
+        else if (state != assetState::failed)
+        {
+            a.priority.store(screenRadius(a.modelMatrix, a.estimate), memory_order_relaxed);
+            if (placeholder)
+            {
+                const meshBounds &b = a.estimate;
+                Matrix place = a.modelMatrix * model::translation(vec3(b.center[0], b.center[1], b.center[2])) *
+                               model::scaling(vec3(b.radius, b.radius, b.radius)) * placeholder->modelMatrix;
+                addToFrame(f, *placeholder, place, placeholder->cull);
+            }
+        }
+    }
+    // 顶点阶段：每个唯一顶点每帧只变换一次
+    f.vertexOut.resize(f.vertexBase.back());
+    f.stats.transformedVertices = f.vertexBase.back();
+    f.rasterTris.clear();
+
+    // 尺寸在提交时就记下，draw 判断上一帧能否显示时不必等它的 clear 执行
+    f.clear = resized || f.width != width || f.height != height;
+    f.width = width;
+    f.height = height;
+
+    // 帧图：clear(尺寸变化时) -> bin；vertex[i] -> setup[i]，setup 按模型顺序成链以保持三角形顺序，
+    // 因此模型 i 的装配 / 剔除可以和模型 i+1 的顶点变换重叠；bin -> raster(含 resolve) -> present
+    // 节点只捕获 f 与模型序号，图的形状只取决于模型个数：个数不变就沿用上次建好的图，每帧不再分配节点
+    taskGraph &g = f.graph;
+    int count = int(f.drawList.size());
+    if (f.graphModels != count)
+    {
+        g.clear();
+        taskGraph::nodeId setup = -1;
+        for (int i = 0; i < count; i++)
+        {
+            auto vertex = g.add([this, &f, i]
+                                { transformModel(f, i); });
+            auto next = g.add([this, &f, i]
+                              { setupTriangles(f, i); });
+            g.precede(vertex, next);
+            if (setup >= 0)
+                g.precede(setup, next);
+            setup = next;
+        }
+        auto clear = g.add([this, &f]
+                           {
+            if (f.clear)
+                clearBuffer(f); });
+        auto bin = g.add([this, &f]
+                         { binTriangles(f); });
+        auto raster = g.add([this, &f]
+                            { rasterizeTiles(f); });
+        auto done = g.add([this, &f]
+                          { present(f); });
+        g.precede(clear, bin);
+        if (setup >= 0)
+            g.precede(setup, bin);
+        g.precede(bin, raster);
+        g.precede(raster, done);
+        f.graphModels = count;
+    }
+    f.inFlight = true;
+    g.start(f.arena, f.done);
+}
+
+void rasterizer::waitFrame(frameContext &f)
+{
+    if (!f.inFlight)
+        return;
+    poolIns.wait(f.done);
+    // 本帧所有任务都已完成，任务内存整体回收
+    f.arena.reset();
+    f.inFlight = false;
+}
+
+void rasterizer::finish()
+{
+    for (auto &f : frames)
+        waitFrame(*f);
+}
+
+void rasterizer::setFramesInFlight(int n)
+{
+    finish();
+    framesInFlight = clamp(n, 1, maxFramesInFlight);
+}
+
+std::span<uint32_t> rasterizer::draw()
+{
+    bool resized = resize;
+    if (resize)
+    {
+        if (pCam)
+            pCam->resize(width, height);
+        resize = false;
+        tilesX = (width + tileBuffer::size - 1) / tileBuffer::size;
+        tilesY = (height + tileBuffer::size - 1) / tileBuffer::size;
+
+        viewportMatrix = {
+            {width / 2., 0, 0, width / 2.},
+            {0, height / 2., 0, height / 2.},
+            {0, 0, 1, 0},
+            {0, 0, 0, 1}};
+    }
+
+    // 上次用这一份的帧已经返回并显示完，可以复用
+    frameContext &f = *frames[nextFrame];
+    waitFrame(f);
+    submitFrame(f, resized);
+    frameContext *out = &f;
+    if (framesInFlight > 1)
+    {
+        // 返回上一帧，调用方显示它的同时本帧在后台完成；刚改过尺寸时没有可用的上一帧
+        frameContext &prev = *frames[nextFrame ^ 1];
+        if (prev.width == width && prev.height == height)
+            out = &prev;
+        nextFrame ^= 1;
+    }
+    waitFrame(*out);
+    shown = out;
+    stats = out->stats;
+    return span<uint32_t>(out->frameBuffer);
+}
+
+void renderStats::operator+=(const renderStats &s)
+{
+    depthPassed += s.depthPassed;
+    shaded += s.shaded;
+    coveredPixels += s.coveredPixels;
+    culled += s.culled;
+    clipped += s.clipped;
+    transformedVertices += s.transformedVertices;
 }
 
 void rasterizer::addLight(vec3 pos)
 {
+    finish();
     lig.lightPos.push_back(pos);
 }
 
 void rasterizer::drawLine(Point begin, Point end, vec3 lineColor)
+{
+    if (shown)
+        drawLine(*shown, begin, end, lineColor);
+}
+
+void rasterizer::drawLine(frameContext &f, Point begin, Point end, vec3 lineColor)
 {
     auto x1 = begin[0];
     auto y1 = begin[1];
@@ -293,10 +952,10 @@ void rasterizer::drawLine(Point begin, Point end, vec3 lineColor)
         double klen = curLen / lineLen;
         float z = -float((1 - klen) * begin[2] + klen * end[2]);
         z -= 0.0001f;
-        if (z <= zBuffer[y * width + x])
+        if (z <= f.zBuffer[y * width + x])
         {
-            setPixel(x, y, int(lineColor[0]), int(lineColor[1]), int(lineColor[2]));
-            zBuffer[y * width + x] = z;
+            setPixel(f, x, y, int(lineColor[0]), int(lineColor[1]), int(lineColor[2]));
+            f.zBuffer[y * width + x] = z;
         }
     };
 
@@ -378,5 +1037,6 @@ void rasterizer::drawLine(Point begin, Point end, vec3 lineColor)
 
 void rasterizer::setBkColor(int r, int g, int b)
 {
+    finish();
     bkColor = (r << 16) | (g << 8) | b;
 }
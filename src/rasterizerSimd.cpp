@@ -0,0 +1,323 @@
+#include "rasterizer.h"
+#include "cpuFeature.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RASTERIZER_X86_SIMD
+#endif
+using namespace std;
+
+// 按像素插值的顶点属性: 深度、观察空间坐标、法线、纹理坐标、顶点颜色
+enum
+{
+    attrZ,
+    attrPosX,
+    attrPosY,
+    attrPosZ,
+    attrNorX,
+    attrNorY,
+    attrNorZ,
+    attrU,
+    attrV,
+    attrR,
+    attrG,
+    attrB,
+    attrCount
+};
+
+// 把三个顶点的属性预乘 1/area，之后 属性 = w0 * a0 + w1 * a1 + w2 * a2
+void rasterizer::triangleAttributes(const rasterTriangle &rt, real invArea, float (*attr)[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        vec3 n = *rt.tri.normal[i];
+        real v[attrCount] = {
+            -rt.tri.getVertex(i).data[2],
+            rt.ctri.getVertex(i).data[0],
+            rt.ctri.getVertex(i).data[1],
+            rt.ctri.getVertex(i).data[2],
+            n[0], n[1], n[2],
+            rt.tri.uTex[i], rt.tri.vTex[i],
+            real(rt.tri.colorR[i]), real(rt.tri.colorG[i]), real(rt.tri.colorB[i])};
+        for (int k = 0; k < attrCount; k++)
+            attr[k][i] = float(v[k] * invArea);
+    }
+}
+
+// 插值结果在 fragmentBatch 中的位置
+static void batchTargets(fragmentBatch &b, float *dst[attrCount])
+{
+    float *t[attrCount] = {nullptr, b.pos[0], b.pos[1], b.pos[2], b.nor[0], b.nor[1], b.nor[2], b.u, b.v, b.color[0], b.color[1], b.color[2]};
+    std::copy_n(t, attrCount, dst);
+}
+
+#ifdef RASTERIZER_X86_SIMD
+
+__attribute__((target("avx2,fma"))) void rasterizer::drawTriangleAvx2(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY)
+{
+    edgeSetup e;
+    if (!setupEdges(rt.tri, startX, startY, e))
+        return;
+    float attr[attrCount][3];
+    triangleAttributes(rt, e.invArea, attr);
+    uint32_t id = uint32_t(&rt - tile.frame->rasterTris.data());
+
+    const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 zero = _mm256_setzero_ps();
+    // 边函数是 2^53 以内的整数，在双精度下逐通道求值没有舍入，转成单精度后符号与零也保持不变
+    __m256d laneStep[3][2];
+    __m256 topLeft[3];
+    for (int i = 0; i < 3; i++)
+    {
+        laneStep[i][0] = _mm256_mul_pd(_mm256_setr_pd(0, 1, 2, 3), _mm256_set1_pd(double(e.stepX[i])));
+        laneStep[i][1] = _mm256_mul_pd(_mm256_setr_pd(4, 5, 6, 7), _mm256_set1_pd(double(e.stepX[i])));
+        topLeft[i] = _mm256_castsi256_ps(_mm256_set1_epi32(e.topLeft[i] ? -1 : 0));
+    }
+
+    fragmentBatch batch;
+    batch.count = 8;
+    float *dst[attrCount];
+    batchTargets(batch, dst);
+    alignas(32) uint32_t color[8];
+    const bool equal = tile.pass == fragmentPass::depthEqual;
+    for (int y = startY; y < endY; y++)
+    {
+        int row = (y - tile.y0) * tileBuffer::size - tile.x0;
+        for (int x = startX; x < endX; x += 8)
+        {
+            // 每 8 个像素从精确的定点行起点重新取基准，不累加误差
+            __m256 w[3];
+            __m256 mask = _mm256_cmp_ps(lane, _mm256_set1_ps(float(endX - x)), _CMP_LT_OQ);
+            for (int i = 0; i < 3; i++)
+            {
+                __m256d base = _mm256_set1_pd(double(e.rowW[i] + e.stepX[i] * (x - startX)));
+                w[i] = _mm256_setr_m128(_mm256_cvtpd_ps(_mm256_add_pd(base, laneStep[i][0])), _mm256_cvtpd_ps(_mm256_add_pd(base, laneStep[i][1])));
+                __m256 inside = _mm256_or_ps(_mm256_cmp_ps(w[i], zero, _CMP_GT_OQ),
+                                             _mm256_and_ps(_mm256_cmp_ps(w[i], zero, _CMP_EQ_OQ), topLeft[i]));
+                mask = _mm256_and_ps(mask, inside);
+            }
+            if (_mm256_testz_ps(mask, mask))
+                continue;
+
+            __m256 z = _mm256_mul_ps(w[0], _mm256_set1_ps(attr[attrZ][0]));
+            z = _mm256_fmadd_ps(w[1], _mm256_set1_ps(attr[attrZ][1]), z);
+            z = _mm256_fmadd_ps(w[2], _mm256_set1_ps(attr[attrZ][2]), z);
+            __m256 oldZ = _mm256_loadu_ps(tile.depth + row + x);
+            mask = _mm256_and_ps(mask, equal ? _mm256_cmp_ps(z, oldZ, _CMP_EQ_OQ) : _mm256_cmp_ps(z, oldZ, _CMP_LT_OQ));
+            int passed = __builtin_popcount(_mm256_movemask_ps(mask));
+            if (!passed)
+                continue;
+            __m256i storeMask = _mm256_castps_si256(mask);
+            if (!equal)
+            {
+                tile.stats.depthPassed += passed;
+                _mm256_maskstore_ps(tile.depth + row + x, storeMask, z);
+            }
+            if (tile.pass == fragmentPass::depthOnly)
+                continue;
+            if (tile.pass == fragmentPass::visibility)
+            {
+                _mm256_maskstore_epi32((int *)(tile.id + row + x), storeMask, _mm256_set1_epi32(int(id)));
+                continue;
+            }
+            tile.stats.shaded += passed;
+
+            for (int k = attrPosX; k < attrCount; k++)
+            {
+                __m256 v = _mm256_mul_ps(w[0], _mm256_set1_ps(attr[k][0]));
+                v = _mm256_fmadd_ps(w[1], _mm256_set1_ps(attr[k][1]), v);
+                v = _mm256_fmadd_ps(w[2], _mm256_set1_ps(attr[k][2]), v);
+                _mm256_store_ps(dst[k], v);
+            }
+            shadeBatch(tile, rt, batch, color);
+
+            _mm256_maskstore_epi32((int *)(tile.color + row + x), storeMask, _mm256_load_si256((const __m256i *)color));
+        }
+        for (int i = 0; i < 3; i++)
+            e.rowW[i] += e.stepY[i];
+    }
+}
+
+__attribute__((target("sse4.2"))) void rasterizer::drawTriangleSse4(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY)
+{
+    edgeSetup e;
+    if (!setupEdges(rt.tri, startX, startY, e))
+        return;
+    float attr[attrCount][3];
+    triangleAttributes(rt, e.invArea, attr);
+    uint32_t id = uint32_t(&rt - tile.frame->rasterTris.data());
+
+    const __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+    const __m128 zero = _mm_setzero_ps();
+    __m128d laneStep[3][2];
+    __m128 topLeft[3];
+    for (int i = 0; i < 3; i++)
+    {
+        laneStep[i][0] = _mm_mul_pd(_mm_setr_pd(0, 1), _mm_set1_pd(double(e.stepX[i])));
+        laneStep[i][1] = _mm_mul_pd(_mm_setr_pd(2, 3), _mm_set1_pd(double(e.stepX[i])));
+        topLeft[i] = _mm_castsi128_ps(_mm_set1_epi32(e.topLeft[i] ? -1 : 0));
+    }
+
+    fragmentBatch batch;
+    batch.count = 4;
+    float *dst[attrCount];
+    batchTargets(batch, dst);
+    alignas(16) uint32_t color[4];
+    const bool equal = tile.pass == fragmentPass::depthEqual;
+    for (int y = startY; y < endY; y++)
+    {
+        int row = (y - tile.y0) * tileBuffer::size - tile.x0;
+        for (int x = startX; x < endX; x += 4)
+        {
+            __m128 w[3];
+            __m128 mask = _mm_cmplt_ps(lane, _mm_set1_ps(float(endX - x)));
+            for (int i = 0; i < 3; i++)
+            {
+                __m128d base = _mm_set1_pd(double(e.rowW[i] + e.stepX[i] * (x - startX)));
+                w[i] = _mm_movelh_ps(_mm_cvtpd_ps(_mm_add_pd(base, laneStep[i][0])), _mm_cvtpd_ps(_mm_add_pd(base, laneStep[i][1])));
+                __m128 inside = _mm_or_ps(_mm_cmpgt_ps(w[i], zero), _mm_and_ps(_mm_cmpeq_ps(w[i], zero), topLeft[i]));
+                mask = _mm_and_ps(mask, inside);
+            }
+            if (!_mm_movemask_ps(mask))
+                continue;
+
+            __m128 z = _mm_mul_ps(w[0], _mm_set1_ps(attr[attrZ][0]));
+            z = _mm_add_ps(z, _mm_mul_ps(w[1], _mm_set1_ps(attr[attrZ][1])));
+            z = _mm_add_ps(z, _mm_mul_ps(w[2], _mm_set1_ps(attr[attrZ][2])));
+            __m128 oldZ = _mm_loadu_ps(tile.depth + row + x);
+            mask = _mm_and_ps(mask, equal ? _mm_cmpeq_ps(z, oldZ) : _mm_cmplt_ps(z, oldZ));
+            int passed = __builtin_popcount(_mm_movemask_ps(mask));
+            if (!passed)
+                continue;
+            if (!equal)
+            {
+                tile.stats.depthPassed += passed;
+                // SSE 没有掩码写，读-混合-写整段；块由单线程独占，不会与其他线程冲突
+                _mm_storeu_ps(tile.depth + row + x, _mm_blendv_ps(oldZ, z, mask));
+            }
+            if (tile.pass == fragmentPass::depthOnly)
+                continue;
+            if (tile.pass == fragmentPass::visibility)
+            {
+                __m128i oldId = _mm_loadu_si128((const __m128i *)(tile.id + row + x));
+                _mm_storeu_si128((__m128i *)(tile.id + row + x), _mm_blendv_epi8(oldId, _mm_set1_epi32(int(id)), _mm_castps_si128(mask)));
+                continue;
+            }
+            tile.stats.shaded += passed;
+
+            for (int k = attrPosX; k < attrCount; k++)
+            {
+                __m128 v = _mm_mul_ps(w[0], _mm_set1_ps(attr[k][0]));
+                v = _mm_add_ps(v, _mm_mul_ps(w[1], _mm_set1_ps(attr[k][1])));
+                v = _mm_add_ps(v, _mm_mul_ps(w[2], _mm_set1_ps(attr[k][2])));
+                _mm_store_ps(dst[k], v);
+            }
+            shadeBatch(tile, rt, batch, color);
+
+            __m128i oldColor = _mm_loadu_si128((const __m128i *)(tile.color + row + x));
+            __m128i newColor = _mm_blendv_epi8(oldColor, _mm_load_si128((const __m128i *)color), _mm_castps_si128(mask));
+            _mm_storeu_si128((__m128i *)(tile.color + row + x), newColor);
+        }
+        for (int i = 0; i < 3; i++)
+            e.rowW[i] += e.stepY[i];
+    }
+}
+
+// AVX-512: 16 个像素一组，覆盖 / 深度测试结果直接放在掩码寄存器里
+__attribute__((target("avx512f,avx512dq,fma"))) void rasterizer::drawTriangleAvx512(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY)
+{
+    edgeSetup e;
+    if (!setupEdges(rt.tri, startX, startY, e))
+        return;
+    float attr[attrCount][3];
+    triangleAttributes(rt, e.invArea, attr);
+    uint32_t id = uint32_t(&rt - tile.frame->rasterTris.data());
+
+    const __m512 zero = _mm512_setzero_ps();
+    __m512d laneStep[3][2];
+    for (int i = 0; i < 3; i++)
+    {
+        laneStep[i][0] = _mm512_mul_pd(_mm512_setr_pd(0, 1, 2, 3, 4, 5, 6, 7), _mm512_set1_pd(double(e.stepX[i])));
+        laneStep[i][1] = _mm512_mul_pd(_mm512_setr_pd(8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_pd(double(e.stepX[i])));
+    }
+
+    fragmentBatch batch;
+    batch.count = 16;
+    float *dst[attrCount];
+    batchTargets(batch, dst);
+    alignas(64) uint32_t color[16];
+    const bool equal = tile.pass == fragmentPass::depthEqual;
+    for (int y = startY; y < endY; y++)
+    {
+        int row = (y - tile.y0) * tileBuffer::size - tile.x0;
+        for (int x = startX; x < endX; x += 16)
+        {
+            __m512 w[3];
+            __mmask16 mask = endX - x >= 16 ? __mmask16(0xffff) : __mmask16((1u << (endX - x)) - 1);
+            for (int i = 0; i < 3; i++)
+            {
+                __m512d base = _mm512_set1_pd(double(e.rowW[i] + e.stepX[i] * (x - startX)));
+                w[i] = _mm512_insertf32x8(_mm512_castps256_ps512(_mm512_cvtpd_ps(_mm512_add_pd(base, laneStep[i][0]))), _mm512_cvtpd_ps(_mm512_add_pd(base, laneStep[i][1])), 1);
+                __mmask16 inside = _mm512_cmp_ps_mask(w[i], zero, _CMP_GT_OQ);
+                if (e.topLeft[i])
+                    inside |= _mm512_cmp_ps_mask(w[i], zero, _CMP_EQ_OQ);
+                mask &= inside;
+            }
+            if (!mask)
+                continue;
+
+            __m512 z = _mm512_mul_ps(w[0], _mm512_set1_ps(attr[attrZ][0]));
+            z = _mm512_fmadd_ps(w[1], _mm512_set1_ps(attr[attrZ][1]), z);
+            z = _mm512_fmadd_ps(w[2], _mm512_set1_ps(attr[attrZ][2]), z);
+            __m512 oldZ = _mm512_maskz_loadu_ps(mask, tile.depth + row + x);
+            mask = equal ? _mm512_mask_cmp_ps_mask(mask, z, oldZ, _CMP_EQ_OQ) : _mm512_mask_cmp_ps_mask(mask, z, oldZ, _CMP_LT_OQ);
+            if (!mask)
+                continue;
+            int passed = __builtin_popcount(mask);
+            if (!equal)
+            {
+                tile.stats.depthPassed += passed;
+                _mm512_mask_storeu_ps(tile.depth + row + x, mask, z);
+            }
+            if (tile.pass == fragmentPass::depthOnly)
+                continue;
+            if (tile.pass == fragmentPass::visibility)
+            {
+                _mm512_mask_storeu_epi32(tile.id + row + x, mask, _mm512_set1_epi32(int(id)));
+                continue;
+            }
+            tile.stats.shaded += passed;
+
+            for (int k = attrPosX; k < attrCount; k++)
+            {
+                __m512 v = _mm512_mul_ps(w[0], _mm512_set1_ps(attr[k][0]));
+                v = _mm512_fmadd_ps(w[1], _mm512_set1_ps(attr[k][1]), v);
+                v = _mm512_fmadd_ps(w[2], _mm512_set1_ps(attr[k][2]), v);
+                _mm512_store_ps(dst[k], v);
+            }
+            shadeBatch(tile, rt, batch, color);
+
+            _mm512_mask_storeu_epi32(tile.color + row + x, mask, _mm512_load_si512(color));
+        }
+        for (int i = 0; i < 3; i++)
+            e.rowW[i] += e.stepY[i];
+    }
+}
+
+#else
+
+void rasterizer::drawTriangleAvx512(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY)
+{
+    drawTriangleEdge(tile, rt, startX, endX, startY, endY);
+}
+
+void rasterizer::drawTriangleAvx2(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY)
+{
+    drawTriangleEdge(tile, rt, startX, endX, startY, endY);
+}
+
+void rasterizer::drawTriangleSse4(tileBuffer &tile, const rasterTriangle &rt, int startX, int endX, int startY, int endY)
+{
+    drawTriangleEdge(tile, rt, startX, endX, startY, endY);
+}
+
+#endif
@@ -73,7 +73,7 @@ bool simpleWindow::shouldClose()
 
 bool simpleWindow::press(char key)
 {
-    return bPress[key];
+    return key >= 0 && bPress[int(key)];
 }
 
 char simpleWindow::getKey()
@@ -2,104 +2,120 @@
 #include <iostream>
 #include <cmath>
 
-void vec3::setValue(double a, double b, double c)
+template <typename T>
+void vec3T<T>::setValue(T a, T b, T c)
 {
     data[0] = a;
     data[1] = b;
     data[2] = c;
 }
 
-vec3 vec3::operator+(vec3 v)
+template <typename T>
+vec3T<T> vec3T<T>::operator+(vec3T v)
 {
-    vec3 res;
+    vec3T res;
     for (int i = 0; i < 3; i++)
         res[i] = data[i] + v[i];
     return res;
 }
 
-void vec3::operator+=(vec3 v)
+template <typename T>
+void vec3T<T>::operator+=(vec3T v)
 {
     for (int i = 0; i < 3; i++)
         data[i] += v[i];
 }
 
-vec3 vec3::operator/(double f)
+template <typename T>
+vec3T<T> vec3T<T>::operator/(T f)
 {
-    vec3 res;
+    vec3T res;
     for (int i = 0; i < 3; i++)
         res[i] = data[i] / f;
     return res;
 }
 
-void vec3::operator/=(double f)
+template <typename T>
+void vec3T<T>::operator/=(T f)
 {
-    for (double &x : data)
+    for (T &x : data)
         x /= f;
 }
 
-vec3 vec3::operator-(vec3 v)
+template <typename T>
+vec3T<T> vec3T<T>::operator-(vec3T v)
 {
-    vec3 res;
+    vec3T res;
     for (int i = 0; i < 3; i++)
         res[i] = data[i] - v[i];
     return res;
 }
 
-vec3 vec3::operator*(double f)
+template <typename T>
+vec3T<T> vec3T<T>::operator*(T f)
 {
-    vec3 res;
+    vec3T res;
     for (int i = 0;i < 3;i++)
         res[i] = data[i] * f;
     return res;
 }
 
-double vec3::operator*(vec3 v)
+template <typename T>
+T vec3T<T>::operator*(vec3T v)
 {
-    double res = 0;
+    T res = 0;
     for (int i = 0; i < 3; i++)
         res += data[i] * v[i];
     return res;
 }
 
-double vec3::len()
+template <typename T>
+T vec3T<T>::len()
 {
-    double len = 0;
-    for (double &f : data)
+    T len = 0;
+    for (T &f : data)
         len += f * f;
-    return sqrt(len);
+    return std::sqrt(len);
 }
 
-vec3 vec3::normalize()
+template <typename T>
+vec3T<T> vec3T<T>::normalize()
 {
-    vec3 res = *this;
+    vec3T res = *this;
     res /= len();
     return res;
 }
 
-vec3 vec3::cross(vec3 v)
+template <typename T>
+vec3T<T> vec3T<T>::cross(vec3T v)
 {
-    vec3 res;
+    vec3T res;
     res[0] = data[1] * v[2] - v[1] * data[2];
     res[1] = data[2] * v[0] - v[2] * data[0];
     res[2] = data[0] * v[1] - v[0] * data[1];
     return res;
 }
 
-void vec3::abs()
+template <typename T>
+void vec3T<T>::abs()
 {
-    double f = 0;
-    for (double g : data)
+    T f = 0;
+    for (T g : data)
         f += g;
     if (f < 0)
     {
-        for (double& g : data)
+        for (T& g : data)
             g = -g;
     }
 }
 
-void vec3::printData()
+template <typename T>
+void vec3T<T>::printData()
 {
-    for (double f : data)
-        printf("%-8.3f",f);
+    for (T f : data)
+        printf("%-8.3f", double(f));
     printf("\n");
 }
+
+template class vec3T<float>;
+template class vec3T<double>;